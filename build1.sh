@@ -6,8 +6,17 @@ output="single"
 # Move into the src directory to locate the source files
 cd src
 
+# Compressed traces are read with the codec libraries that are installed
+codecs=""
+for codec in "zlib.h TRACE_ZLIB -lz" "zstd.h TRACE_ZSTD -lzstd" "lzma.h TRACE_LZMA -llzma"; do
+    set -- $codec
+    if printf "#include <$1>\nint main() { return 0; }\n" | g++ -x c++ - $3 -o /dev/null 2> /dev/null; then
+        codecs="$codecs -D$2 $3"
+    fi
+done
+
 # Compile the project, specify the include directory, and link necessary files
-g++ -g -o $output MainSinCache.cpp Cache.cpp MemoryManager.cpp -I../include
+g++ -g -o $output MainSinCache.cpp CacheBatch.cpp NextUseIndex.cpp Sampling.cpp PartitionedCache.cpp StackDistance.cpp TracePipeline.cpp Cache.cpp CacheTrace.cpp ReplacementPolicy.cpp TraceReader.cpp TraceDecoder.cpp TraceDecompressor.cpp MemoryManager.cpp -I../include -pthread $codecs
 
 # Move back to the project root directory
 cd ..
@@ -3,8 +3,38 @@
 
 #include <vector>
 #include "MemoryManager.h"
+#include "ReplacementPolicy.h"
+#include "CacheTrace.h"
 
 class MemoryManager;
+class NextUseIndex;
+class TraceBuffer;
+
+// Event counts and cycles of one cache level, can be copied as a snapshot and
+// subtracted to get the counts of an interval
+struct CacheStats
+{
+    uint64_t numReadHit;
+    uint64_t numReadMiss;
+    uint64_t numWriteHit;
+    uint64_t numWriteMiss;
+    uint64_t numVictimHit;      // misses served by the victim cache
+    uint64_t numFill;           // blocks brought in from the lower level
+    uint64_t numWriteback;      // evicted blocks written to the lower level
+    uint64_t numBackInvalidate; // blocks invalidated because a lower level evicted them
+    uint64_t numExclusiveSwap;  // misses served by moving the block up from an exclusive lower level
+    uint64_t baseCycles;
+    uint64_t missCycles;
+
+    CacheStats();
+    uint64_t numHit() const { return numReadHit + numWriteHit; }
+    uint64_t numMiss() const { return numReadMiss + numWriteMiss; }
+    uint64_t numAccesses() const { return numHit() + numMiss() + numVictimHit; }
+    float missRate() const { return numAccesses() == 0 ? 0 : (float)numMiss() / numAccesses(); }
+    CacheStats operator-(const CacheStats &other) const;
+    CacheStats &operator+=(const CacheStats &other);
+    void print(const char *name) const;
+};
 
 class Cache
 {
@@ -16,53 +46,125 @@ public:
     bool writeBack;
     bool writeAllocate;
     bool exclusive;
+    bool storeData; // false if the memory is timing only, then blocks hold tags and state but no data
     Cache *lowerCache;
     Cache *victim;
     Cache *higherCache;
     MemoryManager *memory;
-    uint32_t numAccesses;
-    uint32_t numHit;
-    uint32_t numMiss;
-    uint64_t baseCycles;
-    uint64_t missCycles;
+    CacheStats stats;
     uint32_t hitLatency;
     uint32_t missLatency;
 
-    struct Block
-    {
-        bool valid;   // valid bit
-        bool dirty;   // dirty bit
-        uint32_t tag; // tag
-        uint32_t setNum;
-        uint32_t lastAccess;
-        std::vector<uint8_t> data; // data in each block, an array of uint_8
-    };
-
     Cache(MemoryManager *memory, uint32_t hitLatency, uint32_t cacheSize, uint32_t blockSize,
           uint32_t associativity, bool writeBack = true, bool writeAllocate = true, bool exclusive = false,
           Cache *lowerCache = nullptr, Cache *higherCache = nullptr);
+    ~Cache();
+    Cache(const Cache &) = delete;
+    Cache &operator=(const Cache &) = delete;
     void set_lower_cache(Cache *cache);
     uint8_t get_byte(uint32_t addr, uint32_t *cycles);
     void set_byte(uint32_t addr, uint8_t val, uint32_t *cycles = nullptr);
+    // read (isWrite = false) or write size bytes starting at addr, split at block boundaries,
+    // buf is not touched if the cache does not store data
+    void access(uint32_t addr, uint32_t size, bool isWrite, uint8_t *buf, uint32_t *cycles = nullptr);
     void set_victim(Cache *victim);
-    uint32_t get_total_cycles();
+    // the policy is reset, call this before the first access
+    void set_replacement_policy(ReplacementPolicy::Policy policy, uint32_t seed = 1);
+    // replace the policy by Belady's OPT, index has the block accesses this cache will see,
+    // with the same block size, in order. Call before the first access
+    void set_next_use(const NextUseIndex *index);
+    // cycles of this level plus the miss cycles of every level below it
+    uint64_t get_total_cycles();
+    void printStatistics(const char *name);
+    // for RepeatFilter: whether the last access left its block in the cache,
+    // and further accesses to that block counted as hits in bulk
+    bool lastBlockResident() { return this->lastBlockId >= 0 && this->valid[this->lastBlockId]; }
+    bool canRepeatHits() {
+        // a write-through cache recording its miss stream has to record every write,
+        // and OPT has to see every access to follow the index
+        return !this->storeData && (this->writeBack || (this->lowerCache == nullptr && this->missStream == nullptr)) &&
+               this->optPolicy == nullptr;
+    }
+    void repeatHits(uint64_t numReads, uint64_t numWrites, uint32_t *cycles);
+    // record the reads and writes this cache makes to memory, only without a lower cache
+    void set_miss_stream(TraceBuffer *stream) { this->missStream = stream; }
+    // set sampling for a timing-only cache: only 1 of every ratio sets, picked by a hash of
+    // the index, is simulated, accesses to the others are dropped. ratio is a power of 2
+    void setSetSampling(uint32_t ratio);
+    // false if there is no set sampling, or too few sets to sample any
+    bool isSetSampling() { return this->sampleBits != 0; }
+    // the ratio in effect, below the one asked for when the cache has too few sets
+    uint32_t getSetSamplingRatio() { return 1u << this->sampleBits; }
+    uint32_t getNumSets() { return 1u << this->indexBits; }
+    bool isSampledSet(uint32_t set) {
+        // multiplying by an odd constant permutes the indexes, the top bits of the result pick the sets
+        return (((set * 0x9e3779b1u) & ((1u << this->indexBits) - 1)) >> (this->indexBits - this->sampleBits)) == 0;
+    }
+    // the counts of a sampled set
+    void getSetCounts(uint32_t set, uint64_t *accesses, uint64_t *misses, uint64_t *cycles);
 
 private:
     void initializeCache();
     bool inCache(uint32_t addr);
-    uint32_t getTag(uint32_t addr);
-    uint32_t getIndex(uint32_t addr);
-    uint32_t getOffset(uint32_t addr);
-    int findInCache(uint32_t addr);
-    Block getBlockFromLowerLevel(uint32_t addr, uint32_t *cycles = nullptr);
-    void writeBlockToLowerLevel(Block *block, uint32_t addr, uint32_t *cycles = nullptr);
+    uint32_t getTag(uint32_t addr) { return addr >> (this->offsetBits + this->indexBits); }
+    uint32_t getIndex(uint32_t addr) { return (addr >> this->offsetBits) & ((1u << this->indexBits) - 1); }
+    uint32_t getOffset(uint32_t addr) { return addr & (this->blockSize - 1); }
+    int findInCache(uint32_t addr) { return (this->*findFn)(addr); }
+    // 1 for the highest level, used to tag traced events
+    uint32_t getLevel() {
+        uint32_t level = 1;
+        for (Cache *current = this->higherCache; current != nullptr; current = current->higherCache) level++;
+        return level;
+    }
+    void selectSpecialization();
+    void accessSampled(uint32_t addr, uint32_t size, bool isWrite, uint8_t *buf, uint32_t *cycles);
+    template <bool WriteBack, bool WriteAllocate, bool Exclusive, bool HasVictim, bool StoreData>
+    void accessBlock(uint32_t addr, uint32_t size, bool isWrite, uint8_t *buf, uint32_t *cycles);
+    template <uint32_t OffsetBits, uint32_t Ways>
+    int findInSet(uint32_t addr);
+    int findInSetGeneric(uint32_t addr);
+    void readFromLowerLevel(uint32_t addr, uint8_t *buf, uint32_t size, uint32_t *cycles);
+    void writeToLowerLevel(uint32_t addr, uint8_t *buf, uint32_t size, uint32_t *cycles);
+    bool getBlockFromLowerLevel(uint32_t addr, uint8_t *dst, uint32_t *cycles = nullptr);
+    void writeBlockToLowerLevel(uint32_t blockId, uint32_t *cycles = nullptr);
+    uint8_t *getBlockData(uint32_t blockId);
     uint32_t getMemBegin(uint32_t addr);
     uint32_t findReplacedBlockId(uint32_t addr);
     uint32_t getAddrFromBlockId(uint32_t blockId);
     void evictBlockFromHigherCaches(uint32_t addr);
     void evictBlock(uint32_t blockId);
-    void insertToVictim(Block *evictedBlock, uint32_t addr);
-    std::vector<Block> blocks; // an array of blocks, the cache consists of caches, the size is cacheSize/blockSize
+    void insertToVictim(uint32_t evictedBlockId);
+
+    // geometry as bit widths, blockSize, the number of sets and associativity are powers of 2
+    uint32_t offsetBits;
+    uint32_t indexBits;
+    uint32_t wayBits;
+
+    // The block access and the set lookup are instantiated for each combination of
+    // write policy, exclusiveness, victim cache and data mode, and for common geometries.
+    // selectSpecialization() picks the instances once, so the hot path has no branches
+    // on these settings and uses constant shifts
+    typedef void (Cache::*AccessFn)(uint32_t addr, uint32_t size, bool isWrite, uint8_t *buf, uint32_t *cycles);
+    typedef int (Cache::*FindFn)(uint32_t addr);
+    AccessFn accessFn;
+    FindFn findFn;
+
+    // block metadata is kept as separate arrays indexed by blockId, the blocks
+    // of a set are contiguous so a set lookup scans one run of tags
+    std::vector<uint32_t> tags;
+    std::vector<uint8_t> valid;
+    std::vector<uint8_t> dirty;
+    ReplacementPolicy *policy;
+    OPTPolicy *optPolicy; // the policy if set_next_use, nullptr otherwise
+    int lastBlockId; // block of the last access if the access left it in the cache, -1 otherwise
+    TraceBuffer *missStream; // nullptr unless set_miss_stream
+    uint32_t sampleBits; // log2 of the set sampling ratio, 0 simulates every set
+    std::vector<uint64_t> setCounts; // accesses, misses and cycles of every set while sampling
+    // block data, blockSize bytes per block in one aligned arena allocated at
+    // construction, followed by one extra block used to stage fills
+    uint8_t *data;
+    size_t dataSize;
+    uint8_t *fillBuffer;
 };
 
 #endif
\ No newline at end of file
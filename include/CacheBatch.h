@@ -0,0 +1,70 @@
+/*
+ * Several cache configurations simulated in lockstep on one thread. Each
+ * configuration replaying the whole trace on its own would stream the trace
+ * through the host memory once per configuration, so the trace is instead
+ * cut into chunks that fit in the host L2, and every chunk is replayed into
+ * all the caches of the batch before moving on to the next one. A batch of
+ * K caches reads the trace from memory once instead of K times.
+ *
+ * Every cache sees the accesses in trace order, the statistics are the same
+ * as replaying the trace into each cache separately.
+ *
+ * With time sampling the chunks are the sampled windows instead, see
+ * Sampling.h, and with set sampling every cache simulates a subset of its sets.
+ */
+
+#ifndef CACHE_BATCH_H
+#define CACHE_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Cache.h"
+#include "RepeatFilter.h"
+#include "Sampling.h"
+#include "TraceReader.h"
+
+class CacheBatch
+{
+public:
+    // caches of a batch, larger batches gain little as the states of the caches
+    // themselves start to crowd the trace chunk out of the host caches
+    static const size_t DEFAULT_SIZE = 4;
+
+    // records of a chunk, chunkLength 0 sizes it to half the host L2
+    explicit CacheBatch(size_t chunkLength = 0);
+    ~CacheBatch();
+    CacheBatch(const CacheBatch &) = delete;
+    CacheBatch &operator=(const CacheBatch &) = delete;
+
+    // applies to the caches added after it, setRatio 1 simulates every set
+    void setSampling(const TimeSampling &timeSampling, uint32_t setRatio);
+    bool isSampled() { return this->timeSampling.enabled() || this->setRatio > 1; }
+    // the trace carries no data values, so only timing is simulated, returns the index of the cache
+    size_t add(uint32_t cacheSize, uint32_t blockSize, uint32_t associativity, bool writeBack, bool writeAllocate,
+               ReplacementPolicy::Policy policy, bool filterRepeats = false);
+    void run(const TraceBuffer &trace);
+    const CacheStats &getStats(size_t i) { return this->caches[i]->stats; }
+    uint32_t getSetSamplingRatio(size_t i) { return this->caches[i]->getSetSamplingRatio(); }
+    // the estimates of a sampled run
+    void getEstimates(size_t i, Estimate *missRate, Estimate *cpi);
+    size_t size() { return this->caches.size(); }
+    size_t getChunkLength() { return this->chunkLength; }
+
+private:
+    void replay(size_t i, const TraceBuffer &trace, size_t begin, size_t end);
+    void warm(size_t i, const TraceBuffer &trace, size_t begin, size_t end);
+
+    size_t chunkLength;
+    TimeSampling timeSampling;
+    uint32_t setRatio;
+    uint64_t traceLength; // of the last run
+    uint32_t cycles;      // passed to every access, so the caches count cycles
+    std::vector<TimeSampler> samplers;
+    std::vector<MemoryManager *> memories;
+    std::vector<Cache *> caches;
+    std::vector<RepeatFilter *> filters;
+    std::vector<RepeatFilter *> warmFilters; // always filtering, for functional warming
+};
+
+#endif
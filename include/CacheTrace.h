@@ -0,0 +1,52 @@
+/*
+ * Event tracing of the cache hierarchy, compiled in only when CACHE_TRACE is
+ * defined. Every thread records into its own ring buffer, so recording takes
+ * no lock and does no I/O, the ring keeps the latest CAPACITY events of the
+ * thread. The buffers of all threads can be dumped to a binary file at the
+ * end of the run.
+ *
+ * Dump format, little endian:
+ *   header: char magic[8] = "CTRACE1\0", uint32_t eventSize, uint32_t numEvents
+ *   numEvents * CacheEvent, ordered by thread then by sequence number
+ */
+
+#ifndef CACHE_TRACE_H
+#define CACHE_TRACE_H
+
+#include <cstdint>
+
+struct CacheEvent
+{
+    enum Type : uint8_t
+    {
+        FILL,            // a block is brought in from the lower level
+        EVICT,           // a valid block is replaced
+        WRITEBACK,       // an evicted block is written to the lower level
+        BACK_INVALIDATE, // a block is invalidated because a lower level evicted it
+        VICTIM_HIT,      // a miss is served by the victim cache
+    };
+
+    uint64_t seq;    // per-thread sequence number
+    uint32_t addr;   // block address
+    uint8_t type;
+    uint8_t level;   // 1 for L1, the level the event happens in
+    uint16_t thread; // index of the recording thread
+};
+
+class CacheTrace
+{
+public:
+    static const uint32_t CAPACITY = 1 << 16; // events kept per thread, a power of 2
+
+    static void record(CacheEvent::Type type, uint32_t level, uint32_t addr);
+    // write the buffers of every thread to path, false if the file can't be written
+    static bool dump(const char *path);
+};
+
+#ifdef CACHE_TRACE
+#define CACHE_TRACE_EVENT(type, level, addr) CacheTrace::record(CacheEvent::type, (level), (addr))
+#else
+#define CACHE_TRACE_EVENT(type, level, addr) ((void)0)
+#endif
+
+#endif
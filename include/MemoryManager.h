@@ -18,9 +18,12 @@ class Cache;
 class MemoryManager
 {
 public:
-  MemoryManager();
+  // storeData = false makes a timing-only memory: pages are tracked but hold
+  // no bytes, and caches built on it keep only tags and state
+  MemoryManager(bool storeData = true);
   ~MemoryManager();
   Cache *cache;
+  bool storeData;
   bool addPage(uint32_t addr);
   bool isPageExist(uint32_t addr);
 
@@ -30,6 +33,8 @@ public:
   bool setByteNoCache(uint32_t addr, uint8_t val);
   uint8_t getByte(uint32_t addr, uint32_t *cycles = nullptr);
   uint8_t getByteNoCache(uint32_t addr);
+  bool setBytesNoCache(uint32_t addr, const uint8_t *buf, uint32_t len);
+  bool getBytesNoCache(uint32_t addr, uint8_t *buf, uint32_t len);
 
   bool setShort(uint32_t addr, uint16_t val, uint32_t *cycles = nullptr);
   uint16_t getShort(uint32_t addr, uint32_t *cycles = nullptr);
@@ -52,6 +57,8 @@ private:
   uint32_t getSecondEntryId(uint32_t addr);
   uint32_t getPageOffset(uint32_t addr);
   bool isAddrExist(uint32_t addr);
+  bool setBytes(uint32_t addr, const uint8_t *buf, uint32_t len, uint32_t *cycles);
+  bool getBytes(uint32_t addr, uint8_t *buf, uint32_t len, uint32_t *cycles);
 
   uint8_t **memory[1024];
 };
@@ -0,0 +1,132 @@
+/*
+ * Next-use index of a trace for Belady's OPT replacement. For every block
+ * access, split at block boundaries like Cache::access, the index holds the
+ * position of the next access to the same block, so the optimal policy can
+ * evict the block used furthest in the future.
+ *
+ * The index is built in one backward pass over the trace: a map from each
+ * block to the position of its next access gives the entry of every access.
+ * The entries are written to an unlinked temporary file a window at a time,
+ * and each simulated cache reads them back forward through a NextUseReader,
+ * mapped a window at a time like TraceReader. The memory is one map entry
+ * per distinct block and a window, however long the trace, and the 64-bit
+ * positions don't limit its length. A streamed trace is walked backward
+ * from a TraceSpill, below. The index only depends on the block size, every
+ * configuration with that block size can share it.
+ */
+
+#ifndef NEXT_USE_INDEX_H
+#define NEXT_USE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "TraceReader.h"
+
+class TraceSpill;
+
+class NextUseIndex
+{
+public:
+    // the next use of a block that is never accessed again
+    static const uint64_t NEVER = UINT64_MAX;
+    static const size_t WINDOW_SIZE = 1024 * 1024; // entries written or mapped at a time, 8MB
+
+    explicit NextUseIndex(uint32_t blockSize);
+    ~NextUseIndex();
+    NextUseIndex(const NextUseIndex &) = delete;
+    NextUseIndex &operator=(const NextUseIndex &) = delete;
+
+    // index the reads and writes of the trace, false if the file can't be written
+    bool build(const TraceBuffer &trace);
+    // the same for a spilled trace, read back a chunk at a time
+    bool build(const TraceSpill &spill);
+    uint32_t getBlockSize() const { return 1u << this->offsetBits; }
+    // block accesses in the index
+    uint64_t size() const { return this->numAccesses; }
+
+private:
+    friend class NextUseReader;
+
+    uint64_t countAccesses(const TraceBuffer &records) const;
+    bool start(uint64_t numAccesses);
+    // the records from the last, preceding those already added
+    void addBackward(const TraceBuffer &records);
+    void add(uint32_t block);
+    void writeWindow();
+    bool finish();
+
+    uint32_t offsetBits;
+    int fd;
+    uint64_t numAccesses;
+    // the backward pass
+    uint64_t position;                               // of the last entry added
+    std::unordered_map<uint32_t, uint64_t> nextUses; // block -> position of its next access
+    std::vector<uint64_t> window;                    // filled from the back
+    size_t fill;                                     // first entry of window filled
+    bool failed;
+};
+
+// The reads and writes of a streamed trace spilled to an unlinked temporary file, 8 bytes
+// each, so that the backward pass of the index and the replay of OPT can read it back a
+// chunk at a time, which TraceReader can't
+class TraceSpill
+{
+public:
+    static const size_t CHUNK = 64 * 1024; // records written or read at a time
+
+    TraceSpill();
+    ~TraceSpill();
+    TraceSpill(const TraceSpill &) = delete;
+    TraceSpill &operator=(const TraceSpill &) = delete;
+
+    // an unlinked temporary file in $TMPDIR, /tmp by default, -1 on failure
+    static int createTemporary();
+    bool open();
+    void append(TraceBuffer::Operation operation, uint32_t address, uint32_t size);
+    // write the records still buffered, false if anything failed to be written
+    bool flush();
+    uint64_t size() const { return this->numRecords; }
+    // replace the records of chunk with count records from begin, false on a read error
+    bool read(uint64_t begin, size_t count, TraceBuffer *chunk) const;
+
+private:
+    int fd;
+    uint64_t numRecords;          // written or buffered
+    std::vector<uint64_t> buffer; // address in bits 0-31, the kind of TraceBuffer above
+    bool failed;
+};
+
+// reads the entries of an index in order, one per block access of the replayed trace
+class NextUseReader
+{
+public:
+    explicit NextUseReader(const NextUseIndex *index);
+    ~NextUseReader();
+    NextUseReader(const NextUseReader &) = delete;
+    NextUseReader &operator=(const NextUseReader &) = delete;
+
+    // the next use of the next block access, NEVER past the end of the index
+    uint64_t next() {
+        if (this->cur == this->end && !this->mapWindow()) {
+            return NextUseIndex::NEVER;
+        }
+        return *this->cur++;
+    }
+
+private:
+    // map the window that follows, false at the end of the index or if that fails
+    bool mapWindow();
+    void unmapWindow();
+
+    const NextUseIndex *index;
+    uint64_t windowBegin; // entry of the window that follows
+    const uint64_t *window;
+    size_t windowLength;  // entries
+    const uint64_t *cur;
+    const uint64_t *end;
+    std::vector<uint64_t> buffer;
+};
+
+#endif
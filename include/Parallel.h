@@ -0,0 +1,39 @@
+/*
+ * Runs independent jobs on a pool of threads. The jobs are handed out one at
+ * a time from a shared counter, so a thread that finishes a short job takes
+ * the next one and long jobs don't hold the others up.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// the number of hardware threads, at least 1
+inline unsigned defaultNumThreads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// call job(i) for every i in [0, numJobs) on up to numThreads threads, returns when all are done
+inline void parallelFor(size_t numJobs, unsigned numThreads, const std::function<void(size_t)> &job) {
+    if (numThreads > numJobs) numThreads = (unsigned)numJobs;
+    if (numThreads <= 1) {
+        for (size_t i = 0; i < numJobs; i++) job(i);
+        return;
+    }
+    std::atomic<size_t> nextJob(0);
+    auto worker = [&]() {
+        for (size_t i = nextJob++; i < numJobs; i = nextJob++) job(i);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < numThreads; t++) threads.emplace_back(worker);
+    worker();
+    for (std::thread &thread : threads) thread.join();
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * One single-level cache configuration simulated on several threads. Sets
+ * never interact, so worker w owns the sets whose index ends in the bits of
+ * w and simulates them in a Cache of its own that holds just that slice of
+ * the sets. The calling thread dispatches the accesses into one SPSC queue
+ * per worker, which keeps the order within every set, and the statistics of
+ * the workers are added up at the end.
+ *
+ * The result equals a single-thread run for the policies that keep their
+ * state per set. BRRIP and RANDOM share state across sets, see isExact().
+ */
+
+#ifndef PARTITIONED_CACHE_H
+#define PARTITIONED_CACHE_H
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "Cache.h"
+#include "SpscQueue.h"
+#include "TracePipeline.h"
+#include "TraceReader.h"
+
+class PartitionedCache
+{
+public:
+    // numWorkers is rounded down to a power of 2 no larger than the number of sets
+    PartitionedCache(uint32_t numWorkers, uint32_t cacheSize, uint32_t blockSize, uint32_t associativity,
+                     bool writeBack, bool writeAllocate, ReplacementPolicy::Policy policy, bool filterRepeats = false);
+    ~PartitionedCache();
+    PartitionedCache(const PartitionedCache &) = delete;
+    PartitionedCache &operator=(const PartitionedCache &) = delete;
+
+    static bool isExact(ReplacementPolicy::Policy policy);
+    // simulate the trace, the statistics are those of the whole cache
+    CacheStats run(const TraceBuffer &trace);
+    CacheStats run(TracePipeline &pipeline);
+    uint32_t getNumWorkers() { return this->numWorkers; }
+
+private:
+    struct Access
+    {
+        uint32_t addr; // address in the worker's cache, the worker bits of the index removed
+        uint16_t size;
+        bool isWrite;
+    };
+
+    void startWorkers();
+    void dispatch(uint32_t addr, uint32_t size, bool isWrite);
+    CacheStats finish();
+
+    uint32_t numWorkers;
+    uint32_t workerBits;
+    uint32_t blockSize;
+    uint32_t offsetBits;
+    uint32_t indexBits;
+    bool filterRepeats; // every worker puts a RepeatFilter in front of its cache
+    std::vector<MemoryManager *> memories;
+    std::vector<Cache *> caches;
+    std::vector<SpscQueue<Access> *> queues;
+    std::vector<std::thread> workers;
+};
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Run-length filter in front of a cache. Traces touch the same block many
+ * times in a row (a loop over an array, the bytes of a word), and every such
+ * access after the first one is a hit that changes nothing but the counters.
+ * The filter passes the first access of a run to the cache, then only counts
+ * the reads and writes that stay in its block, and applies them together
+ * through Cache::repeatHits when the run ends.
+ *
+ * The statistics equal those of the unfiltered cache once flush() is called.
+ * A cache that stores data or writes through to a lower level has to see
+ * every access, the filter then passes them all.
+ */
+
+#ifndef REPEAT_FILTER_H
+#define REPEAT_FILTER_H
+
+#include <cstdint>
+#include "Cache.h"
+
+class RepeatFilter
+{
+public:
+    RepeatFilter(Cache *cache, bool enabled) {
+        this->cache = cache;
+        this->enabled = enabled;
+        this->offsetBits = 0;
+        while ((1u << this->offsetBits) < cache->blockSize) this->offsetBits++;
+        this->inRun = false;
+        this->block = 0;
+        this->numReads = 0;
+        this->numWrites = 0;
+        this->cycles = nullptr;
+    }
+    RepeatFilter(const RepeatFilter &) = delete;
+    RepeatFilter &operator=(const RepeatFilter &) = delete;
+
+    // like Cache::access, buf is only used by the accesses passed to the cache
+    void access(uint32_t addr, uint32_t size, bool isWrite, uint8_t *buf, uint32_t *cycles = nullptr) {
+        bool oneBlock = (addr >> this->offsetBits) == ((addr + size - 1) >> this->offsetBits);
+        if (this->inRun) {
+            if (oneBlock && (addr >> this->offsetBits) == this->block && cycles == this->cycles) {
+                if (isWrite) {
+                    this->numWrites++;
+                } else {
+                    this->numReads++;
+                }
+                return;
+            }
+            this->flush();
+        }
+        this->cache->access(addr, size, isWrite, buf, cycles);
+        // the cache is asked at every run, its miss stream may be set after the filter is made
+        if (this->enabled && oneBlock && this->cache->lastBlockResident() && this->cache->canRepeatHits()) {
+            this->inRun = true;
+            this->block = addr >> this->offsetBits;
+            this->cycles = cycles;
+        }
+    }
+
+    // apply the pending run, call before reading the statistics of the cache
+    void flush() {
+        if (!this->inRun) return;
+        if (this->numReads + this->numWrites > 0) {
+            this->cache->repeatHits(this->numReads, this->numWrites, this->cycles);
+        }
+        this->inRun = false;
+        this->numReads = 0;
+        this->numWrites = 0;
+    }
+
+private:
+    Cache *cache;
+    bool enabled;
+    uint32_t offsetBits;
+    bool inRun;
+    uint32_t block; // address >> offsetBits of the run
+    uint64_t numReads;
+    uint64_t numWrites;
+    uint32_t *cycles; // of the first access of the run
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Replacement policies of a cache, chosen per cache level
+ *   LRU: true LRU, each set keeps its ways in a recency list
+ *   PLRU: tree pseudo-LRU, one bit per inner node of a binary tree over the ways
+ *   SRRIP: static re-reference interval prediction with 2-bit counters
+ *   BRRIP: bimodal RRIP, most blocks are inserted with a distant re-reference
+ *   FIFO: evict the block that was filled earliest
+ *   RANDOM: evict a random way, seeded so runs are reproducible
+ *   OPT: Belady's optimal policy, evict the block used furthest in the future,
+ *        it needs the next-use index of the trace, see Cache::set_next_use
+ *
+ * A policy is only asked for a victim when every way of the set is valid,
+ * the cache itself fills invalid ways first.
+ */
+
+#ifndef REPLACEMENT_POLICY_H
+#define REPLACEMENT_POLICY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class NextUseIndex;
+class NextUseReader;
+
+class ReplacementPolicy
+{
+public:
+    enum Policy
+    {
+        LRU,
+        PLRU,
+        SRRIP,
+        BRRIP,
+        FIFO,
+        RANDOM,
+        OPT, // not created by create() or parsePolicy()
+    };
+
+    static ReplacementPolicy *create(Policy policy, uint32_t numSets, uint32_t associativity, uint32_t seed = 1);
+    static bool parsePolicy(const std::string &name, Policy *policy);
+    static std::string policyName(Policy policy);
+
+    virtual ~ReplacementPolicy() {}
+    // a valid block is accessed
+    virtual void touch(uint32_t set, uint32_t way) = 0;
+    // a block is placed in the way
+    virtual void insert(uint32_t set, uint32_t way) = 0;
+    // the way to evict from a full set
+    virtual uint32_t getVictim(uint32_t set) = 0;
+    virtual Policy getPolicy() = 0;
+};
+
+// Recency list per set, kept as prev/next arrays of ways, all operations O(1)
+class LRUPolicy final : public ReplacementPolicy
+{
+public:
+    LRUPolicy(uint32_t numSets, uint32_t associativity, bool moveOnHit = true);
+    void touch(uint32_t set, uint32_t way) override;
+    void insert(uint32_t set, uint32_t way) override;
+    uint32_t getVictim(uint32_t set) override;
+    Policy getPolicy() override;
+
+private:
+    void moveToFront(uint32_t set, uint32_t way);
+
+    uint32_t associativity;
+    bool moveOnHit; // false gives FIFO, the list is then in fill order
+    std::vector<uint32_t> prev;
+    std::vector<uint32_t> next;
+    std::vector<uint32_t> head; // most recently used way of each set
+    std::vector<uint32_t> tail; // least recently used way of each set
+};
+
+// Binary tree over the ways, O(log ways) per operation, associativity must be a power of 2
+class PLRUPolicy final : public ReplacementPolicy
+{
+public:
+    PLRUPolicy(uint32_t numSets, uint32_t associativity);
+    void touch(uint32_t set, uint32_t way) override;
+    void insert(uint32_t set, uint32_t way) override;
+    uint32_t getVictim(uint32_t set) override;
+    Policy getPolicy() override;
+
+private:
+    uint32_t associativity;
+    std::vector<uint8_t> bits; // node i of a set at [set * associativity + i], root is node 1
+};
+
+// 2-bit re-reference prediction values, a victim is a way predicted for the distant future
+class RRIPPolicy final : public ReplacementPolicy
+{
+public:
+    RRIPPolicy(uint32_t numSets, uint32_t associativity, bool bimodal);
+    void touch(uint32_t set, uint32_t way) override;
+    void insert(uint32_t set, uint32_t way) override;
+    uint32_t getVictim(uint32_t set) override;
+    Policy getPolicy() override;
+
+private:
+    static const uint8_t MAX_RRPV = 3;
+    static const uint32_t BIMODAL_PERIOD = 32; // BRRIP inserts 1 in 32 blocks like SRRIP
+
+    uint32_t associativity;
+    bool bimodal;
+    uint32_t numInserts;
+    std::vector<uint8_t> rrpv;
+};
+
+class RandomPolicy final : public ReplacementPolicy
+{
+public:
+    RandomPolicy(uint32_t associativity, uint32_t seed);
+    void touch(uint32_t set, uint32_t way) override;
+    void insert(uint32_t set, uint32_t way) override;
+    uint32_t getVictim(uint32_t set) override;
+    Policy getPolicy() override;
+
+private:
+    uint32_t associativity;
+    uint32_t state; // xorshift32 state
+};
+
+// Belady's OPT, each way keeps the next use of its block, the cache advances
+// the policy to the next entry of the index before every block access
+class OPTPolicy final : public ReplacementPolicy
+{
+public:
+    OPTPolicy(uint32_t numSets, uint32_t associativity, const NextUseIndex *index);
+    ~OPTPolicy();
+    void advance();
+    void touch(uint32_t set, uint32_t way) override;
+    void insert(uint32_t set, uint32_t way) override;
+    uint32_t getVictim(uint32_t set) override;
+    Policy getPolicy() override;
+
+private:
+    uint32_t associativity;
+    NextUseReader *reader;
+    uint64_t current; // next use of the block accessed
+    std::vector<uint64_t> nextUses;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Reuse-distance analysis of a trace for one block size. The reuse distance
+ * of an access is the number of distinct blocks accessed since the previous
+ * access to its block, and a fully-associative LRU cache of C blocks hits
+ * exactly the accesses at a distance below C. One pass thus gives the miss
+ * ratio curve of every capacity, where MainSinCache simulates each one.
+ *
+ * Exact mode: every block keeps the time of its last access, and a Fenwick
+ * tree over the times marks the last access of each block, so the distance
+ * is the number of marks after the previous access, O(log n) per access.
+ * The times are renumbered when the tree is full, which keeps its size
+ * proportional to the number of distinct blocks rather than to the trace.
+ *
+ * SHARDS mode: only the blocks whose hash is below a threshold are tracked,
+ * a rate R of them, and their distances are scaled by 1/R. With maxBlocks
+ * set the threshold is lowered whenever more blocks would be tracked,
+ * evicting the blocks of the highest hash, so the memory stays constant
+ * whatever the trace. The counts are rescaled at every change of the rate,
+ * and the difference between the expected and the actual number of sampled
+ * accesses is added to the shortest distance (SHARDS-adj).
+ *
+ * The histogram has power-of-2 buckets: bucket 0 holds distance 0 and
+ * bucket k the distances in [2^(k-1), 2^k), so the miss ratio is exact at
+ * power-of-2 capacities.
+ */
+
+#ifndef REUSE_DISTANCE_H
+#define REUSE_DISTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+class ReuseDistance
+{
+public:
+    // exact analysis
+    explicit ReuseDistance(uint32_t blockSize);
+    // SHARDS with an initial sampling rate in (0, 1], maxBlocks 0 keeps the rate fixed
+    ReuseDistance(uint32_t blockSize, double rate, size_t maxBlocks);
+
+    // an access of size bytes, split at block boundaries like Cache::access
+    void access(uint32_t addr, uint32_t size);
+
+    uint32_t getBlockSize() const { return 1u << this->offsetBits; }
+    // block accesses, sampled or not
+    uint64_t getNumAccesses() const { return this->numAccesses; }
+    double getRate() const { return (double)this->threshold / HASH_RANGE; }
+    // estimated accesses of each bucket, and of first accesses to a block
+    std::vector<double> getHistogram() const;
+    double getColdMisses() const;
+    // miss ratio of a fully-associative LRU cache with capacity blocks, a power of 2
+    double missRatio(uint64_t capacity) const;
+
+private:
+    static const uint64_t HASH_RANGE = 1ull << 24;
+
+    void accessBlock(uint32_t block);
+    void lowerThreshold();
+    void mark(uint32_t time, int delta);
+    // marks at times in [0, time)
+    uint32_t countBefore(uint32_t time) const;
+    void renumber();
+    static uint64_t hashBlock(uint32_t block);
+
+    uint32_t offsetBits;
+    bool sampled;
+    size_t maxBlocks;
+    uint64_t threshold; // blocks of hash below it are tracked, HASH_RANGE in exact mode
+    uint64_t numAccesses;
+
+    uint32_t now;                                   // the next time
+    std::vector<uint32_t> tree;                     // Fenwick tree over the times
+    std::unordered_map<uint32_t, uint32_t> lastUse; // block -> time of its last access
+    std::set<std::pair<uint64_t, uint32_t>> tracked; // (hash, block) of the tracked blocks, SHARDS with maxBlocks
+
+    std::vector<double> buckets;
+    double cold;
+};
+
+#endif
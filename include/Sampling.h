@@ -0,0 +1,95 @@
+/*
+ * Statistical sampling of long traces, the miss rate and CPI are estimated
+ * with a 95% confidence interval instead of simulated exactly.
+ *
+ * Time sampling (SMARTS): the trace is cut into periods, and the last `unit`
+ * records of every period are measured after the `warmup` records before
+ * them are simulated to refresh the cache. The rest of the period goes
+ * through functional warming, which keeps the tags and replacement state of
+ * the caches up to date on a cheaper path that counts nothing, so large
+ * caches are not left cold or stale. Each unit is one sample. Without
+ * functional warming the rest is skipped, which gives a speedup of about
+ * period / (unit + warmup) but biases the caches that take longer than the
+ * warmup to refill.
+ *
+ * Set sampling: Cache simulates only a hashed subset of its sets, see
+ * Cache::setSetSampling, each sampled set is one sample. The speedup is the
+ * sampling ratio, minus the cost of reading the records that are dropped.
+ *
+ * The miss rate is a ratio estimate over the samples, misses over accesses,
+ * its variance that of a ratio estimator with the finite population
+ * correction, so the interval shrinks to 0 as the samples cover everything.
+ */
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <cstdint>
+#include "Cache.h"
+
+// an estimate and the half width of its 95% confidence interval
+struct Estimate
+{
+    double value;
+    double halfWidth;
+};
+
+// the ratio sum(y) / sum(x) of the samples (x, y)
+class RatioEstimator
+{
+public:
+    RatioEstimator();
+    void add(double y, double x);
+    // populationSize is the number of units the samples were drawn from
+    Estimate estimate(double populationSize) const;
+    uint64_t size() const { return this->n; }
+
+private:
+    uint64_t n;
+    double sumX;
+    double sumY;
+    double sumXX;
+    double sumXY;
+    double sumYY;
+};
+
+struct TimeSampling
+{
+    uint64_t unit;
+    uint64_t period; // 0 if time sampling is off
+    uint64_t warmup;
+    bool functionalWarming; // the records between the windows update the caches without being timed
+
+    TimeSampling() : unit(0), period(0), warmup(0), functionalWarming(true) {}
+    // "unit,period[,warmup[,warming]]", the warmup is one unit by default, warming 0 turns functional warming off
+    bool parse(const char *arg);
+    bool enabled() const { return this->period > 0; }
+    // sample k measures [unitBegin(k), unitBegin(k) + unit), after warming up from warmupBegin(k)
+    uint64_t numSamples(uint64_t length) const { return length / this->period; }
+    uint64_t unitBegin(uint64_t k) const { return (k + 1) * this->period - this->unit; }
+    uint64_t warmupBegin(uint64_t k) const { return this->unitBegin(k) - this->warmup; }
+    // the records of sample k before its warmup, after the unit of sample k - 1
+    uint64_t skippedBegin(uint64_t k) const { return k == 0 ? 0 : this->unitBegin(k - 1) + this->unit; }
+};
+
+// the samples of one cache under time sampling, the statistics are taken
+// before and after every unit
+class TimeSampler
+{
+public:
+    void beginUnit(const CacheStats &stats) { this->before = stats; }
+    // numRecords: records in the unit, including those not simulated, the CPI is per record
+    void endUnit(const CacheStats &stats, uint64_t numRecords);
+    // the estimates for a trace of length records
+    void estimate(const TimeSampling &sampling, uint64_t length, Estimate *missRate, Estimate *cpi) const;
+
+private:
+    CacheStats before;
+    RatioEstimator misses; // per access
+    RatioEstimator cycles; // per record
+};
+
+// the estimates of a set-sampled cache after a trace of length records
+void estimateSetSampled(Cache *cache, uint64_t length, Estimate *missRate, Estimate *cpi);
+
+#endif
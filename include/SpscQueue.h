@@ -0,0 +1,147 @@
+/*
+ * Bounded lock-free queue with one producer thread and one consumer thread.
+ * Each side keeps a cached copy of the other side's index, so the shared
+ * cache lines are only touched when the cached copy says the queue looks
+ * full or empty. push() and pop() spin (yielding) for a while on a full or
+ * empty queue, then block on a condition variable until the other side
+ * makes progress, so a stalled side doesn't keep a core busy. close() ends
+ * the stream once the consumer has drained it.
+ *
+ * The fast path doesn't fence: a side that makes progress only wakes the
+ * other one if it sees its waiting flag, and a wake-up lost to the race
+ * between the flag and the index costs one timed wait, not a hang.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+template <typename T>
+class SpscQueue
+{
+public:
+    // capacity is rounded up to a power of 2
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        this->items.resize(size);
+        this->mask = size - 1;
+        this->head.store(0, std::memory_order_relaxed);
+        this->tail.store(0, std::memory_order_relaxed);
+        this->closed.store(false, std::memory_order_relaxed);
+        this->producerWaiting.store(false, std::memory_order_relaxed);
+        this->consumerWaiting.store(false, std::memory_order_relaxed);
+        this->cachedHead = 0;
+        this->cachedTail = 0;
+    }
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // producer side
+    bool tryPush(const T &item) {
+        size_t t = this->tail.load(std::memory_order_relaxed);
+        if (t - this->cachedHead > this->mask) {
+            this->cachedHead = this->head.load(std::memory_order_acquire);
+            if (t - this->cachedHead > this->mask) return false;
+        }
+        this->items[t & this->mask] = item;
+        this->tail.store(t + 1, std::memory_order_release);
+        this->wake(this->consumerWaiting);
+        return true;
+    }
+    void push(const T &item) {
+        for (uint32_t spin = 0; !this->tryPush(item); spin++) {
+            if (spin < SPIN_LIMIT) {
+                std::this_thread::yield();
+            } else {
+                this->wait(this->producerWaiting, [this]() {
+                    return this->tail.load(std::memory_order_relaxed) - this->head.load(std::memory_order_acquire) <=
+                           this->mask;
+                });
+            }
+        }
+    }
+    void close() {
+        this->closed.store(true, std::memory_order_release);
+        this->wake(this->consumerWaiting);
+    }
+
+    // consumer side
+    bool tryPop(T *item) {
+        size_t h = this->head.load(std::memory_order_relaxed);
+        if (h == this->cachedTail) {
+            this->cachedTail = this->tail.load(std::memory_order_acquire);
+            if (h == this->cachedTail) return false;
+        }
+        *item = this->items[h & this->mask];
+        this->head.store(h + 1, std::memory_order_release);
+        this->wake(this->producerWaiting);
+        return true;
+    }
+    // false once the queue is closed and empty
+    bool pop(T *item) {
+        for (uint32_t spin = 0; !this->tryPop(item); spin++) {
+            if (this->closed.load(std::memory_order_acquire)) {
+                // items pushed before close() are visible now
+                return this->tryPop(item);
+            }
+            if (spin < SPIN_LIMIT) {
+                std::this_thread::yield();
+            } else {
+                this->wait(this->consumerWaiting, [this]() {
+                    return this->head.load(std::memory_order_relaxed) != this->tail.load(std::memory_order_acquire) ||
+                           this->closed.load(std::memory_order_acquire);
+                });
+            }
+        }
+        return true;
+    }
+
+private:
+    // the padding keeps the consumer and producer fields on separate cache lines
+    static const size_t CACHE_LINE = 64;
+    // yields before a side blocks, and the longest a lost wake-up can delay it
+    static const uint32_t SPIN_LIMIT = 64;
+    static const int WAIT_MS = 1;
+
+    template <typename Ready>
+    void wait(std::atomic<bool> &waiting, Ready ready) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        waiting.store(true);
+        while (!ready()) {
+            this->changed.wait_for(lock, std::chrono::milliseconds(WAIT_MS));
+        }
+        waiting.store(false, std::memory_order_relaxed);
+    }
+    void wake(std::atomic<bool> &waiting) {
+        if (waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->changed.notify_one();
+        }
+    }
+
+    std::vector<T> items;
+    size_t mask;
+    char pad0[CACHE_LINE];
+    std::atomic<size_t> head; // next item to pop, written by the consumer
+    size_t cachedTail;        // consumer's copy of tail
+    char pad1[CACHE_LINE];
+    std::atomic<size_t> tail; // next free slot, written by the producer
+    size_t cachedHead;        // producer's copy of head
+    char pad2[CACHE_LINE];
+    std::atomic<bool> closed;
+    std::atomic<bool> producerWaiting; // blocked in push()
+    std::atomic<bool> consumerWaiting; // blocked in pop()
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+#endif
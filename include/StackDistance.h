@@ -0,0 +1,54 @@
+/*
+ * LRU stack-distance (Mattson) simulation. For a fixed block size and number
+ * of sets, the blocks of a write-allocate LRU cache with A ways are the top A
+ * entries of the LRU stack of their set, so one pass over the trace gives the
+ * statistics of every associativity up to maxWays at once.
+ *
+ * Dirty blocks are tracked with a threshold per stack entry: the block is
+ * dirty in every cache with at least `dirtyFrom` ways. A write makes it dirty
+ * in all of them, a read at distance d refills it clean in the caches with
+ * fewer than d ways, so the threshold becomes max(dirtyFrom, d).
+ *
+ * The sets are fixed: configurations with another number of sets need
+ * another pass, there is no all-associativity pass over every set count.
+ *
+ * Only write-allocate caches keep the stack property, a write miss that
+ * doesn't allocate leaves the smaller caches out of order. Those
+ * configurations have to be simulated with Cache.
+ */
+
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+
+#include <cstdint>
+#include <vector>
+#include "Cache.h"
+
+class StackDistance
+{
+public:
+    StackDistance(uint32_t numSets, uint32_t blockSize, uint32_t maxWays);
+
+    // an access of size bytes, split at block boundaries like Cache::access
+    void access(uint32_t addr, uint32_t size, bool isWrite);
+    // statistics of a write-allocate LRU cache with the given ways, the
+    // counters and cycles match the ones Cache collects for that configuration
+    CacheStats getStats(uint32_t ways, bool writeBack, uint32_t hitLatency, uint32_t missLatency);
+
+private:
+    void accessBlock(uint32_t block, bool isWrite);
+
+    uint32_t numSets;
+    uint32_t offsetBits;
+    uint32_t maxWays;
+    std::vector<uint32_t> blocks;    // stack of each set at [set * maxWays], most recent first
+    std::vector<uint8_t> dirtyFrom;  // dirty threshold of each stack entry, maxWays + 1 if clean
+    std::vector<uint8_t> depth;      // number of entries in the stack of each set
+    std::vector<uint64_t> readHits;  // reads at stack distance d, at [d - 1]
+    std::vector<uint64_t> writeHits; // writes at stack distance d, at [d - 1]
+    std::vector<uint64_t> dirtyEvictions; // dirty blocks evicted by caches with A ways, at [A - 1]
+    uint64_t numReads;
+    uint64_t numWrites;
+};
+
+#endif
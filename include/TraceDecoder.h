@@ -0,0 +1,78 @@
+/*
+ * Decoders of the trace formats of other tools, so their traces are read
+ * without being rewritten first. TraceReader hands a decoder the bytes of
+ * the window, text or binary, and the decoder turns one record into the
+ * accesses it holds:
+ *   DINERO: Dinero din, "label address" per line, label 0 read, 1 write,
+ *           2 instruction fetch, 3 and 4 escapes (skipped). Hex address
+ *           without 0x, the rest of the line is ignored. Every access is 1 byte
+ *   LACKEY: Valgrind lackey, "I  addr,size", " L addr,size", " S addr,size",
+ *           " M addr,size" (a load then a store). Other lines, like the
+ *           ==pid== banner, are skipped
+ *   CHAMPSIM: ChampSim input_instr, 64 bytes per instruction: the ip, branch
+ *           and register fields, 2 store and 4 load addresses, 0 if unused.
+ *           An instruction is a fetch, then its loads, then its stores, each
+ *           1 byte
+ * A malformed record ends the trace in every format, as in the text format.
+ * Instruction fetches are the operation 'i', counted as an access of the
+ * trace but not simulated. The pc of a data access is the address of the
+ * last fetch before it. Addresses are truncated to their low 32 bits.
+ */
+
+#ifndef TRACE_DECODER_H
+#define TRACE_DECODER_H
+
+#include <cstdint>
+#include <string>
+#include "TraceReader.h"
+
+class TraceDecoder
+{
+public:
+    static const uint32_t MAX_ACCESSES = 8; // of a single record
+
+    // nullptr for the native formats, which TraceReader parses itself
+    static TraceDecoder *create(TraceReader::Format format);
+    // the format of a trace that has no binary magic, from its path and its first bytes
+    static TraceReader::Format detect(const char *path, const char *head, size_t length);
+    static bool parseFormat(const std::string &name, TraceReader::Format *format);
+    static std::string formatName(TraceReader::Format format);
+
+    virtual ~TraceDecoder() {}
+    // decode the next record at *pos into accesses, skipping records that
+    // hold none. False at the end of the window, or if the record is cut by
+    // it and the window isn't the last one, or if it is malformed. *pos only
+    // moves past whole records
+    virtual bool decode(const char **pos, const char *end, bool lastWindow, TraceAccess *accesses,
+                        uint32_t *count) = 0;
+};
+
+class DineroDecoder final : public TraceDecoder
+{
+public:
+    DineroDecoder() : pc(0) {}
+    bool decode(const char **pos, const char *end, bool lastWindow, TraceAccess *accesses, uint32_t *count) override;
+
+private:
+    uint32_t pc;
+};
+
+class LackeyDecoder final : public TraceDecoder
+{
+public:
+    LackeyDecoder() : pc(0) {}
+    bool decode(const char **pos, const char *end, bool lastWindow, TraceAccess *accesses, uint32_t *count) override;
+
+private:
+    uint32_t pc;
+};
+
+class ChampSimDecoder final : public TraceDecoder
+{
+public:
+    static const size_t RECORD_SIZE = 64;
+
+    bool decode(const char **pos, const char *end, bool lastWindow, TraceAccess *accesses, uint32_t *count) override;
+};
+
+#endif
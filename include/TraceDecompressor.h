@@ -0,0 +1,102 @@
+/*
+ * Decompresses a gzip, zstd or xz trace on a thread of its own. The thread
+ * fills a few fixed-size chunks and hands them to the reader through an
+ * SPSC queue, the reader hands each one back through a second queue once it
+ * is parsed, like the batches of TracePipeline. With only NUM_CHUNKS chunks
+ * the decompressed trace is never held whole, however long it is.
+ *
+ * An uncompressed pipe goes through the same thread with the codec NONE,
+ * which copies the input. Its chunks are handed over as soon as the
+ * producer pauses, so the records of a live producer are parsed as they
+ * arrive rather than when a chunk fills up.
+ *
+ * A codec is compiled in when its library is found: TRACE_ZLIB (-lz),
+ * TRACE_ZSTD (-lzstd) and TRACE_LZMA (-llzma).
+ */
+
+#ifndef TRACE_DECOMPRESSOR_H
+#define TRACE_DECOMPRESSOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "SpscQueue.h"
+
+class TraceDecompressor
+{
+public:
+    enum Codec
+    {
+        NONE,
+        GZIP,
+        ZSTD,
+        XZ,
+    };
+
+    static const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+    static const size_t NUM_CHUNKS = 4;
+    static const size_t INPUT_SIZE = 1024 * 1024; // compressed bytes read at a time
+    static const size_t MAGIC_SIZE = 6;           // enough bytes to detect every codec
+
+    TraceDecompressor();
+    ~TraceDecompressor();
+    TraceDecompressor(const TraceDecompressor &) = delete;
+    TraceDecompressor &operator=(const TraceDecompressor &) = delete;
+
+    // the codec of a file starting with head, NONE if it isn't compressed
+    static Codec detect(const uint8_t *head, size_t length);
+    static bool isSupported(Codec codec);
+    static const char *getName(Codec codec);
+
+    // start decompressing fd from its current position, fd stays owned by
+    // the caller and must outlive the decompressor. The head bytes, already
+    // read from a pipe to detect the codec, are decompressed first
+    bool start(int fd, Codec codec, const uint8_t *head = nullptr, size_t headLength = 0);
+    // the next chunk, nullptr once the stream is done. last is set with the
+    // final chunk, which may be empty. The chunk stays valid until the next call
+    const char *nextChunk(size_t *length, bool *last);
+    // the stream was corrupt or could not be read
+    bool failed() { return this->error.load(); }
+
+private:
+    void run();
+    bool runCopy();
+#if defined(TRACE_ZLIB)
+    bool runGzip();
+#endif
+#if defined(TRACE_ZSTD)
+    bool runZstd();
+#endif
+#if defined(TRACE_LZMA)
+    bool runXz();
+#endif
+    // read compressed input, 0 at the end of the file, -1 on an error
+    long readInput() { return this->readFile(this->input.data(), INPUT_SIZE); }
+    long readFile(void *dest, size_t length);
+    // the output side shared by the codecs, false once the reader is gone
+    bool acquireChunk();
+    void pushChunk(bool last);
+
+    int fd;
+    Codec codec;
+    std::thread thread;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> head; // read before the file
+    size_t headPos;
+    uint64_t inputOffset; // compressed bytes read so far
+    std::vector<std::vector<char>> chunks;
+    std::vector<size_t> chunkLengths;
+    std::vector<uint8_t> chunkLast;
+    SpscQueue<uint32_t> fullChunks; // decompressor to reader
+    SpscQueue<uint32_t> freeChunks; // reader to decompressor, closed when the reader is gone
+    std::atomic<bool> stopping; // the reader is gone, the thread stops early
+    std::atomic<bool> error;
+    uint32_t outChunk;  // being filled by the decompressor
+    size_t outLength;
+    int currentChunk;   // held by the reader, -1 if none
+    bool done;          // the reader got the last chunk
+};
+
+#endif
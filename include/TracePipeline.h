@@ -0,0 +1,62 @@
+/*
+ * Streams a trace to the simulation through a reader thread. The reader
+ * parses records into fixed-size batches and hands them over through an
+ * SPSC queue, the consumer hands every batch back through a second queue
+ * once it is done with it. There are only NUM_BATCHES batches, so a reader
+ * that gets ahead waits for the consumer and memory stays bounded whatever
+ * the length of the trace.
+ */
+
+#ifndef TRACE_PIPELINE_H
+#define TRACE_PIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "SpscQueue.h"
+#include "TraceReader.h"
+
+struct TraceRecord
+{
+    uint32_t address;
+    uint32_t pc;       // 0 when the format doesn't carry it
+    uint8_t operation; // TraceBuffer::Operation
+    uint8_t size;
+};
+
+class TracePipeline
+{
+public:
+    static const size_t BATCH_SIZE = 16384; // records per batch
+    static const size_t NUM_BATCHES = 8;
+
+    TracePipeline();
+    ~TracePipeline();
+    TracePipeline(const TracePipeline &) = delete;
+    TracePipeline &operator=(const TracePipeline &) = delete;
+
+    // open the trace and start the reader thread
+    bool open(const char *path, TraceReader::Format format = TraceReader::AUTO);
+    // the next batch of records, nullptr at the end of the trace. The batch
+    // stays valid until the next call, which hands it back to the reader
+    const TraceRecord *nextBatch(size_t *count);
+    // records handed out so far
+    uint64_t getNumRecords() { return this->numRecords; }
+
+private:
+    void readerLoop();
+
+    TraceReader reader;
+    std::thread readerThread;
+    std::vector<std::vector<TraceRecord>> batches;
+    std::vector<size_t> batchCounts;
+    SpscQueue<uint32_t> fullBatches;  // reader to consumer
+    SpscQueue<uint32_t> freeBatches;  // consumer to reader, closed when the consumer is gone
+    std::atomic<bool> stopping;       // the consumer is gone, the reader stops early
+    int currentBatch;                 // held by the consumer, -1 if none
+    uint64_t numRecords;
+};
+
+#endif
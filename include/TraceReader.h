@@ -0,0 +1,182 @@
+/*
+ * Reader and writer of memory traces. Two native formats are read, told
+ * apart by the first bytes of the file, and those of other tools through a
+ * TraceDecoder, see TraceDecoder.h.
+ *
+ * Text, one access per line:
+ *   r 0x122e80
+ *   w 0x134608
+ * The operation is the first non-blank character, the address is hex with an
+ * optional 0x prefix, any blanks (including the trailing tabs of the sample
+ * traces) separate the fields. This matches reading the file with
+ * `file >> operation >> std::hex >> address`. Every access is 1 byte.
+ *
+ * Binary, little endian:
+ *   header: char magic[8] = "MTRACEB\0", uint32_t version = 1, uint32_t reserved,
+ *           uint64_t numRecords, 0 if the trace was written to a pipe
+ *   records, each a tag byte then a varint:
+ *     tag bits 0-1: operation, 0 read 'r', 1 write 'w', 3 other (the character follows the tag)
+ *     tag bits 2-3: log2 of the access size
+ *     tag bits 4-6: low 3 bits of the zigzag encoded address delta
+ *     tag bit 7:    the delta continues in a LEB128 varint holding delta >> 3
+ *   The delta is the address minus the previous address (0 before the first
+ *   record) modulo 2^32, zigzag encoded so small negative strides stay short.
+ * A typical record takes 2-3 bytes against 11 of text.
+ *
+ * The file is mapped a window at a time, so traces larger than memory are
+ * streamed and the pages already parsed are dropped. A gzip, zstd or xz
+ * compressed file is decompressed on the fly by a TraceDecompressor instead
+ * and parsed a chunk at a time, either format can be compressed.
+ *
+ * The path "-" reads stdin. Stdin, a pipe or a FIFO can't be mapped, it is
+ * read by a TraceDecompressor too, which also keeps the memory bounded. Such
+ * an input can't be rewound.
+ *
+ * The format is detected unless open() is given one: the binary header,
+ * then a ChampSim path, then the first line of a din or lackey trace, text
+ * otherwise.
+ */
+
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "TraceDecompressor.h"
+
+class TraceDecoder;
+
+// one access of a trace, pc is 0 when the format doesn't carry it
+struct TraceAccess
+{
+    char operation;
+    uint32_t address;
+    uint32_t size;
+    uint32_t pc;
+};
+
+class TraceReader
+{
+public:
+    enum Format
+    {
+        TEXT,
+        BINARY,
+        DINERO,
+        LACKEY,
+        CHAMPSIM,
+        AUTO, // detected by open()
+    };
+
+    static const size_t WINDOW_SIZE = 64 * 1024 * 1024; // much larger than a page, so a cut record fits in the next window
+
+    TraceReader();
+    ~TraceReader();
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    bool open(const char *path, Format format = AUTO);
+    void close();
+    // read the next access, false at the end of the trace or on a malformed record
+    bool next(char *operation, uint32_t *address, uint32_t *size = nullptr, uint32_t *pc = nullptr);
+    // go back to the beginning of the trace, false on a pipe
+    bool rewind();
+    Format getFormat() { return this->format; }
+
+private:
+    // a record cut by the end of a window that isn't the last one is not parsed
+    static bool parseRecord(const char **pos, const char *end, bool lastWindow, char *operation, uint32_t *address);
+    bool decodeRecord(char *operation, uint32_t *address, uint32_t *size);
+    bool nextDecoded(char *operation, uint32_t *address, uint32_t *size, uint32_t *pc);
+    // the record at cur is cut by the end of the window, false if no window brings more of it
+    bool retryWindow();
+    // continue with a window starting at cur, false if that fails
+    bool advanceWindow();
+    bool mapWindow(uint64_t offset);
+    void unmapWindow();
+    bool startDecompressor(const uint8_t *head = nullptr, size_t headLength = 0);
+    bool refillBuffer();
+
+    int fd;
+    Format format;
+    uint64_t fileSize;
+    uint64_t windowOffset;   // file offset of the window, page aligned
+    const char *window;      // the mapped window, or buffer.data() without mmap
+    size_t windowLength;
+    const char *cur;         // next byte to parse
+    const char *end;         // end of the window
+    bool lastWindow;         // the window reaches the end of the file
+    uint32_t prevAddress;    // of the binary delta encoding
+    std::vector<char> buffer;
+    bool seekable;           // a regular file, not a pipe
+    TraceDecompressor::Codec codec;
+    TraceDecompressor *decompressor; // of a compressed file or a pipe, nullptr if the file is mapped
+    TraceDecoder *decoder;   // of a foreign format, nullptr for the native ones
+    TraceAccess pending[8];  // accesses of the last decoded record, TraceDecoder::MAX_ACCESSES
+    uint32_t numPending;
+    uint32_t pendingPos;
+};
+
+// A whole trace decoded into memory, 5 bytes per access, without the pc. It is read-only
+// once loaded, so any number of simulations can replay it, also concurrently
+class TraceBuffer
+{
+public:
+    enum Operation : uint8_t
+    {
+        READ,
+        WRITE,
+        OTHER, // counted as an access of the trace but not simulated
+    };
+
+    bool load(const char *path, TraceReader::Format format = TraceReader::AUTO);
+    // the size is kept rounded down to 1, 2, 4 or 8 bytes
+    static uint32_t roundSize(uint32_t size) { return size >= 8 ? 8 : size >= 4 ? 4 : size >= 2 ? 2 : 1; }
+    void append(Operation operation, uint32_t address, uint32_t size) {
+        uint8_t sizeBits = size >= 8 ? 3 : size >= 4 ? 2 : size >= 2 ? 1 : 0;
+        this->addresses.push_back(address);
+        this->kinds.push_back(operation | sizeBits << 2);
+    }
+    size_t size() const { return this->addresses.size(); }
+    uint32_t getAddress(size_t i) const { return this->addresses[i]; }
+    Operation getOperation(size_t i) const { return (Operation)(this->kinds[i] & 3); }
+    uint32_t getSize(size_t i) const { return 1u << (this->kinds[i] >> 2); }
+    void clear() {
+        this->addresses.clear();
+        this->kinds.clear();
+    }
+
+private:
+    std::vector<uint32_t> addresses;
+    std::vector<uint8_t> kinds; // operation in bits 0-1, log2 of the access size in bits 2-3
+};
+
+class TraceWriter
+{
+public:
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 24;
+
+    TraceWriter();
+    ~TraceWriter();
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    // the path "-" writes stdout
+    bool open(const char *path);
+    // size must be 1, 2, 4 or 8
+    void write(char operation, uint32_t address, uint32_t size = 1);
+    // complete the header, false if anything failed to be written
+    bool close();
+    uint64_t getNumRecords() { return this->numRecords; }
+
+private:
+    FILE *file;
+    uint64_t numRecords;
+    uint32_t prevAddress;
+};
+
+#endif
@@ -1,366 +1,601 @@
-#include <iostream>
-#include <cmath>
-#include "Cache.h"
-
-Cache::Cache(MemoryManager *memory, uint32_t hitLatency, uint32_t cacheSize, uint32_t blockSize, uint32_t associativity,
-             bool writeBack, bool writeAllocate, bool exclusive,  Cache *lowerCache, Cache *higherCache) {
-    this->cacheSize = cacheSize;
-    this->blockSize = blockSize;
-    this->associativity = associativity;
-    this->numBlocks = cacheSize / blockSize;
-    this->writeBack = writeBack;
-    this->writeAllocate = writeAllocate;
-    this->lowerCache = lowerCache;
-    this->victim = nullptr;
-    this->higherCache = higherCache;
-    this->exclusive = exclusive;
-    this->memory = memory;
-    this->numAccesses = 0;
-    this->numHit = 0;
-    this->numMiss = 0;
-    this->baseCycles = 0;
-    this->missCycles = 0;
-    this->hitLatency = hitLatency;
-    this->missLatency = 100;
-    // initialize the cache
-    this->initializeCache();
-}
-
-uint8_t Cache::get_byte(uint32_t addr, uint32_t *cycles) {
-    this->numAccesses++;
-    if (cycles != nullptr) this->baseCycles += this->hitLatency;
-    uint32_t index = this->getIndex(addr);
-    uint32_t tag = this->getTag(addr);
-    uint32_t offset = this->getOffset(addr);
-
-    int blockId = this->findInCache(addr);
-    if (blockId != -1) {
-        // if the block is in cache
-        this->numHit++;
-        this->blocks[blockId].lastAccess = this->numAccesses;
-        return this->blocks[blockId].data[offset];
-    } else {
-        // cache miss
-        if (this->victim != nullptr) {
-            // check in victim cache
-            int victimBlockId = this->victim->findInCache(addr); // the blockId in victim that contains addr
-            // this->missCycles += this->victim->hitLatency;
-            if (victimBlockId != -1) {
-                this->victim->blocks[victimBlockId].lastAccess = this->numAccesses;
-                return this->victim->blocks[victimBlockId].data[offset];
-            }
-        }
-        this->numMiss++;
-        Block block;
-        block = this->getBlockFromLowerLevel(addr, cycles);  // construct a block with data from lower-level cache.
-        if (cycles != nullptr) this->missCycles += this->missLatency;
-
-        // find the blockId to place the new block
-        uint32_t replacedBlockId = findReplacedBlockId(addr);
-        if ((this->blocks[replacedBlockId].valid && this->blocks[replacedBlockId].dirty && !this->exclusive) || 
-            (this->blocks[replacedBlockId].valid && this->exclusive)) {
-
-            writeBlockToLowerLevel(&this->blocks[replacedBlockId], addr, cycles);
-            if (cycles != nullptr) this->missCycles += this->missLatency;
-        }
-
-        if (this->victim != nullptr && this->blocks[replacedBlockId].valid) {
-            this->insertToVictim(&this->blocks[replacedBlockId], this->getAddrFromBlockId(replacedBlockId));
-            // this->missCycles += this->victim->hitLatency;
-        }
-        this->blocks[replacedBlockId] = block;
-        return block.data[offset];
-    }
-}
-
-void Cache::set_byte(uint32_t addr, uint8_t val, uint32_t *cycles) {
-    this->numAccesses++;
-    if (cycles != nullptr) this->baseCycles += this->hitLatency;
-    uint32_t index = this->getIndex(addr);
-    uint32_t tag = this->getTag(addr);
-    uint32_t offset = this->getOffset(addr);
-
-    int blockId = this->findInCache(addr);
-    if (blockId != -1) {
-        // if the block is in cache
-        this->numHit++;
-        this->blocks[blockId].lastAccess = this->numAccesses;
-        this->blocks[blockId].dirty = true;
-        this->blocks[blockId].data[offset] = val; // modify the data in cache
-        if (!this->writeBack) {
-            // if write through
-            this->writeBlockToLowerLevel(&this->blocks[blockId], addr, cycles); // modify the data in lower level
-            if (cycles != nullptr) this->missCycles += missLatency;
-        }
-    } else {
-        // cache miss
-        this->numMiss++;
-        if (writeAllocate) {
-            Block block = this->getBlockFromLowerLevel(addr, cycles);  // construct a block with data from lower-level cache.
-            if (cycles != nullptr) this->missCycles += this->missLatency;
-            block.data[offset] = val; // change the data in cache
-            block.dirty = true;
-            uint32_t replacedBlockId = findReplacedBlockId(addr); // find the blockId to place the new block
-            if ((this->blocks[replacedBlockId].valid && this->blocks[replacedBlockId].dirty && !this->exclusive) || 
-                (this->blocks[replacedBlockId].valid && this->exclusive)) {
-                writeBlockToLowerLevel(&this->blocks[replacedBlockId], addr, cycles);
-                if (cycles != nullptr) this->missCycles += this->missLatency;
-            }
-            this->blocks[replacedBlockId] = block;
-        } else {
-            if (cycles != nullptr) this->missCycles += missLatency;
-            if (this->lowerCache == nullptr) {
-                this->memory->setByteNoCache(addr, val);
-            } else {
-                this->lowerCache->set_byte(addr, val, cycles);
-            }
-        }
-    }
-}
-
-void Cache::insertToVictim(Block *evictedBlock, uint32_t addr) {
-    // find a free block in victim and replace it by evictedBlock
-    int replaceIdx = -1;
-    for (uint32_t i = 0; i < this->victim->associativity; i++) {
-        if (!this->victim->blocks[i].valid) {
-            replaceIdx = i;
-            break;
-        }
-    }
-    if (replaceIdx == -1) {
-        replaceIdx = 0;
-        uint32_t current = this->victim->blocks[0].lastAccess;
-        for (uint32_t i = 0; i < this->victim->associativity; i++) {
-            if (this->victim->blocks[i].lastAccess < current) {
-                replaceIdx = i;
-                current = this->victim->blocks[i].lastAccess;
-            }
-        }
-    }
-    this->victim->blocks[replaceIdx].data = evictedBlock->data;
-    this->victim->blocks[replaceIdx].valid = true;
-    this->victim->blocks[replaceIdx].tag = this->victim->getTag(addr);
-    this->victim->blocks[replaceIdx].setNum = 0;
-    this->victim->blocks[replaceIdx].lastAccess = this->numAccesses;
-}
-
-uint32_t Cache::getAddrFromBlockId(uint32_t blockId) {
-    uint32_t offsetDigit = log2(this->blockSize);
-    uint32_t indexDigit = log2(this->numBlocks / this->associativity);
-    Block &b = this->blocks[blockId];
-    uint32_t tag = b.tag;
-    uint32_t index = b.setNum;
-    uint32_t address = (tag << (indexDigit + offsetDigit)) | (index << offsetDigit);
-    return address;
-}
-
-void Cache::initializeCache() {
-    this->blocks.resize(this->numBlocks);
-    for (uint32_t i = 0; i < this->numBlocks; i++) {
-        Block &block = this->blocks[i];
-        block.valid = false;
-        block.tag = 0;
-        block.setNum = i / this->associativity;
-        block.data.resize(this->blockSize);
-        block.lastAccess = 0;
-        block.dirty = false;
-    }
-    // std::cout << "-----initialization success-----" << std::endl;
-}
-
-void Cache::set_lower_cache(Cache *cache) {
-    this->lowerCache = cache;
-    cache->higherCache = this;
-    this->missLatency = cache->hitLatency;
-}
-
-void Cache::set_victim(Cache *victim) {
-    this->victim = victim;
-}
-
-uint32_t Cache::findReplacedBlockId(uint32_t addr) {
-    uint32_t index = this->getIndex(addr);
-    uint32_t start = this->associativity * index;
-    uint32_t end = this->associativity * (index + 1);
-
-    // find invalid blocks
-    for (uint32_t i = start; i < end; i++) {
-        if (!this->blocks[i].valid) {
-            return i;
-        }
-    }
-
-    // the set in cache is full, evict a block using LRU, return the blockId with the lowest reference count
-    uint32_t evictedBlockId = this->associativity * index;
-    uint32_t current = this->blocks[evictedBlockId].lastAccess;
-    for (uint32_t i = start; i < end; i++) {
-        if (this->blocks[i].lastAccess < current) {
-            evictedBlockId = i;
-            current = this->blocks[i].lastAccess;
-        }
-    }
-
-    if (!this->exclusive) {this->evictBlockFromHigherCaches(getAddrFromBlockId(evictedBlockId));}
-
-    return evictedBlockId;
-}
-
-void Cache::evictBlockFromHigherCaches(uint32_t addr) {
-    if (this->higherCache != nullptr) { 
-        uint32_t blockId = this->higherCache->findInCache(addr);
-        if (blockId != -1) {
-            std::cout << "-----back invalidate!-----" << std::endl;
-            // Evict the block from the higher cache
-            this->higherCache->evictBlock(blockId);
-            // Recursive call to ensure the block is removed from all higher levels
-            this->higherCache->evictBlockFromHigherCaches(addr);
-        }
-    }
-}
-
-void Cache::evictBlock(uint32_t blockId) {
-    // Evicts the block at blockId from this cache
-    if (this->blocks[blockId].valid && this->blocks[blockId].dirty && this->lowerCache == nullptr) {
-        uint32_t addr = this->getAddrFromBlockId(blockId);
-        uint32_t blockBegin = getMemBegin(addr);
-        for (uint32_t i = blockBegin; i < blockBegin + this->blockSize; i++) {
-            this->memory->setByteNoCache(i, this->blocks[blockId].data[i-blockBegin]);
-        }
-    }
-    // Invalidate the block
-    this->blocks[blockId].valid = false;
-    this->blocks[blockId].dirty = false;
-}
-
-void Cache::writeBlockToLowerLevel(Cache::Block *block, uint32_t addr, uint32_t *cycles) {
-    uint32_t blockBegin = getMemBegin(addr);
-    if (this->exclusive) {
-        if (this->lowerCache != nullptr) {
-            uint32_t replacedBlockId = this->lowerCache->findReplacedBlockId(addr);
-            if (this->lowerCache->blocks[replacedBlockId].valid) {
-                this->lowerCache->writeBlockToLowerLevel(&this->lowerCache->blocks[replacedBlockId], addr, cycles);
-                if (cycles != nullptr) this->missCycles += this->missLatency;
-            }
-            // replace the blocks[blockId] in lower cache by the block from upper cache
-            this->lowerCache->blocks[replacedBlockId] = *block;
-            this->lowerCache->blocks[replacedBlockId].valid = true;
-            this->lowerCache->blocks[replacedBlockId].tag = this->lowerCache->getTag(addr);
-            this->lowerCache->blocks[replacedBlockId].setNum = this->lowerCache->getIndex(addr);
-            this->lowerCache->blocks[replacedBlockId].lastAccess = this->numAccesses;
-        } else if (block->dirty && this->lowerCache == nullptr) {
-            // No lower cache and block is dirty, write back to memory
-            for (uint32_t i = blockBegin; i < blockBegin + this->blockSize; i++) {
-                this->memory->setByteNoCache(i, block->data[i - blockBegin]);
-            }
-        }
-    } else {
-
-        for (uint32_t i = blockBegin; i < blockBegin + this->blockSize; i++) {
-            if (this->lowerCache == nullptr) {
-                this->memory->setByteNoCache(i, block->data[i-blockBegin]);
-            } else {
-                this->lowerCache->set_byte(i, block->data[i-blockBegin], cycles);
-            }
-        }
-    }
-}
-
-Cache::Block Cache::getBlockFromLowerLevel(uint32_t addr, uint32_t *cycles) {
-    Block newBlock;
-    uint32_t blockBegin = getMemBegin(addr);
-    newBlock.data = std::vector<uint8_t>(this->blockSize);
-    if (this->exclusive) {
-        Cache *current = this->lowerCache;
-        while (current != nullptr) {
-            if (cycles != nullptr) this->missCycles += current->hitLatency;
-
-            int blockId = current->findInCache(addr);
-            if (blockId != -1) {
-                newBlock = current->blocks[blockId];
-                current->blocks[blockId].valid = false;
-                current->blocks[blockId].dirty = false;
-                break;
-            } else {
-                current = current->lowerCache;
-            }
-        }
-        if (current == nullptr) {
-            for (uint32_t i = blockBegin; i < blockBegin + this->blockSize; i++) {
-                newBlock.data[i - blockBegin] = this->memory->getByteNoCache(i);
-            }
-            newBlock.dirty = false;
-        }
-        newBlock.valid = true;
-        newBlock.tag = this->getTag(addr);
-        newBlock.setNum = this->getIndex(addr);
-        newBlock.lastAccess = this->numAccesses;
-        return newBlock;
-    } else {
-        // inclusive cache, get block recursively
-        for (uint32_t i = blockBegin; i < blockBegin + this->blockSize; i++) {
-            if (this->lowerCache == nullptr) {
-                newBlock.data[i-blockBegin] = this->memory->getByteNoCache(i);
-            } else {
-                newBlock.data[i-blockBegin] = this->lowerCache->get_byte(i, cycles);
-            }
-        }
-        newBlock.valid = true;
-        newBlock.dirty = false;
-        newBlock.tag = this->getTag(addr);
-        newBlock.setNum = this->getIndex(addr);
-        newBlock.lastAccess = this->numAccesses;
-        return newBlock;
-    }
-}
-
-// get the beginning address of the block of addr in memory
-uint32_t Cache::getMemBegin(uint32_t addr) {
-    return (addr / blockSize) * this->blockSize;
-    // uint32_t offsetDigit = log2(this->blockSize);
-    // uint32_t mask = ~(1 << offsetDigit) - 1; // 11111100000
-    // return addr & mask;
-}
-
-int Cache::findInCache(uint32_t addr) {
-    uint32_t index = this->getIndex(addr);
-    uint32_t tag = this->getTag(addr);
-    // if the block is in the cache, return the block number, otherwise return -1
-    for (uint32_t i = this->associativity * index; i < this->associativity * (index + 1); i++) {
-        // for blocks in the corresponding set
-        if (this->blocks[i].valid && (this->blocks[i].tag == tag)) {
-            // std::cout << "find in Cache!" << std::endl;
-            return i;
-        }
-    }
-    return -1;
-}
-
-uint32_t Cache::getTag(uint32_t addr) {
-    uint32_t offsetDigit = log2(this->blockSize);
-    uint32_t indexDigit = log2(this->numBlocks / this->associativity);
-    uint32_t mask = (1 << (32 - offsetDigit - indexDigit)) - 1;
-    return (addr >> (offsetDigit + indexDigit)) & mask;
-}
-
-uint32_t Cache::getIndex(uint32_t addr) {
-    uint32_t offsetDigit = log2(this->blockSize);
-    uint32_t indexDigit = log2(this->numBlocks / this->associativity);
-    uint32_t mask = (1 << indexDigit) - 1;
-    return (addr >> offsetDigit) & mask;
-}
-
-uint32_t Cache::getOffset(uint32_t addr) {
-    uint32_t offsetDigit = log2(this->blockSize);
-    uint32_t mask = (1 << offsetDigit) - 1;
-    return addr & mask;
-}
-
-uint32_t Cache::get_total_cycles() {
-    uint32_t result = this->baseCycles + this->missCycles;
-    Cache *current = this->lowerCache;
-    while (current != nullptr) {
-        result += current->missCycles;
-        current = current->lowerCache;
-    }
-    return result;
-}
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "Cache.h"
+#include "TraceReader.h"
+
+// The arena is page aligned and zeroed, large arenas are backed by huge pages
+// where the kernel supports it
+static uint8_t *allocateArena(size_t size) {
+#if defined(__linux__)
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+#ifdef MADV_HUGEPAGE
+    if (size >= (2u << 20)) madvise(p, size, MADV_HUGEPAGE);
+#endif
+    return (uint8_t *)p;
+#else
+    void *p = nullptr;
+    if (posix_memalign(&p, 64, size) != 0) return nullptr;
+    memset(p, 0, size);
+    return (uint8_t *)p;
+#endif
+}
+
+static void freeArena(uint8_t *arena, size_t size) {
+#if defined(__linux__)
+    munmap(arena, size);
+#else
+    free(arena);
+#endif
+}
+
+Cache::Cache(MemoryManager *memory, uint32_t hitLatency, uint32_t cacheSize, uint32_t blockSize, uint32_t associativity,
+             bool writeBack, bool writeAllocate, bool exclusive,  Cache *lowerCache, Cache *higherCache) {
+    this->cacheSize = cacheSize;
+    this->blockSize = blockSize;
+    this->associativity = associativity;
+    this->numBlocks = cacheSize / blockSize;
+    this->writeBack = writeBack;
+    this->writeAllocate = writeAllocate;
+    this->lowerCache = lowerCache;
+    this->victim = nullptr;
+    this->higherCache = higherCache;
+    this->exclusive = exclusive;
+    this->memory = memory;
+    this->storeData = memory->storeData;
+    this->hitLatency = hitLatency;
+    this->missLatency = 100;
+    this->offsetBits = log2(blockSize);
+    this->indexBits = log2(this->numBlocks / associativity);
+    this->wayBits = log2(associativity);
+    // initialize the cache
+    this->initializeCache();
+    this->selectSpecialization();
+}
+
+Cache::~Cache() {
+    delete this->policy;
+    if (this->data != nullptr) freeArena(this->data, this->dataSize);
+}
+
+uint8_t Cache::get_byte(uint32_t addr, uint32_t *cycles) {
+    uint8_t val = 0;
+    this->access(addr, 1, false, &val, cycles);
+    return val;
+}
+
+void Cache::set_byte(uint32_t addr, uint8_t val, uint32_t *cycles) {
+    this->access(addr, 1, true, &val, cycles);
+}
+
+void Cache::access(uint32_t addr, uint32_t size, bool isWrite, uint8_t *buf, uint32_t *cycles) {
+    // an access crossing a block boundary is split into one access per block
+    while (size > 0) {
+        uint32_t len = this->blockSize - this->getOffset(addr);
+        if (len > size) len = size;
+        if (this->optPolicy != nullptr) this->optPolicy->advance();
+        if (this->sampleBits == 0) {
+            (this->*accessFn)(addr, len, isWrite, buf, cycles);
+        } else {
+            this->accessSampled(addr, len, isWrite, buf, cycles);
+        }
+        addr += len;
+        buf += len;
+        size -= len;
+    }
+}
+
+void Cache::accessSampled(uint32_t addr, uint32_t size, bool isWrite, uint8_t *buf, uint32_t *cycles) {
+    uint32_t set = this->getIndex(addr);
+    if (!this->isSampledSet(set)) {
+        this->lastBlockId = -1;
+        return;
+    }
+    uint64_t accesses = this->stats.numAccesses();
+    uint64_t misses = this->stats.numMiss();
+    uint64_t totalCycles = this->stats.baseCycles + this->stats.missCycles;
+    (this->*accessFn)(addr, size, isWrite, buf, cycles);
+    uint64_t *counts = &this->setCounts[3 * (size_t)set];
+    counts[0] += this->stats.numAccesses() - accesses;
+    counts[1] += this->stats.numMiss() - misses;
+    counts[2] += this->stats.baseCycles + this->stats.missCycles - totalCycles;
+}
+
+void Cache::setSetSampling(uint32_t ratio) {
+    this->sampleBits = 0;
+    while ((2u << this->sampleBits) <= ratio && this->sampleBits < this->indexBits) this->sampleBits++;
+    this->setCounts.assign(this->sampleBits == 0 ? 0 : 3 * (size_t)this->getNumSets(), 0);
+}
+
+void Cache::getSetCounts(uint32_t set, uint64_t *accesses, uint64_t *misses, uint64_t *cycles) {
+    const uint64_t *counts = &this->setCounts[3 * (size_t)set];
+    *accesses = counts[0];
+    *misses = counts[1];
+    *cycles = counts[2];
+}
+
+template <bool WriteBack, bool WriteAllocate, bool Exclusive, bool HasVictim, bool StoreData>
+void Cache::accessBlock(uint32_t addr, uint32_t size, bool isWrite, uint8_t *buf, uint32_t *cycles) {
+    if (cycles != nullptr) this->stats.baseCycles += this->hitLatency;
+    uint32_t offset = this->getOffset(addr);
+
+    int blockId = this->findInCache(addr);
+    this->lastBlockId = blockId;
+    if (blockId != -1) {
+        // if the block is in cache
+        if (isWrite) {
+            this->stats.numWriteHit++;
+        } else {
+            this->stats.numReadHit++;
+        }
+        this->policy->touch(blockId >> this->wayBits, blockId & (this->associativity - 1));
+        if (!isWrite) {
+            if (StoreData) memcpy(buf, this->getBlockData(blockId) + offset, size);
+            return;
+        }
+        this->dirty[blockId] = true;
+        if (StoreData) memcpy(this->getBlockData(blockId) + offset, buf, size); // modify the data in cache
+        if (!WriteBack) {
+            // if write through, modify the data in lower level
+            this->writeToLowerLevel(addr, buf, size, cycles);
+            if (cycles != nullptr) this->stats.missCycles += missLatency;
+        }
+        return;
+    }
+
+    // cache miss
+    if (HasVictim) {
+        // check in victim cache
+        int victimBlockId = this->victim->findInCache(addr); // the blockId in victim that contains addr
+        if (victimBlockId != -1) {
+            if (isWrite) {
+                // the write goes to this cache or below, the victim copy would become stale
+                this->victim->valid[victimBlockId] = false;
+            } else {
+                this->stats.numVictimHit++;
+                CACHE_TRACE_EVENT(VICTIM_HIT, this->getLevel(), addr - offset);
+                this->victim->policy->touch(0, victimBlockId);
+                if (StoreData) memcpy(buf, this->victim->getBlockData(victimBlockId) + offset, size);
+                return;
+            }
+        }
+    }
+    if (isWrite) {
+        this->stats.numWriteMiss++;
+    } else {
+        this->stats.numReadMiss++;
+    }
+    if (isWrite && !WriteAllocate) {
+        if (cycles != nullptr) this->stats.missCycles += missLatency;
+        this->writeToLowerLevel(addr, buf, size, cycles);
+        return;
+    }
+
+    // stage the block from lower-level cache, the lower level may back-invalidate
+    // blocks of this set while filling, so the replaced block is chosen afterwards
+    bool blockDirty = this->getBlockFromLowerLevel(addr, this->fillBuffer, cycles);
+    this->stats.numFill++;
+    CACHE_TRACE_EVENT(FILL, this->getLevel(), addr - offset);
+    if (cycles != nullptr) this->stats.missCycles += this->missLatency;
+
+    // find the blockId to place the new block
+    uint32_t replacedBlockId = findReplacedBlockId(addr);
+    if (this->valid[replacedBlockId]) {
+        CACHE_TRACE_EVENT(EVICT, this->getLevel(), this->getAddrFromBlockId(replacedBlockId));
+    }
+    if (this->valid[replacedBlockId] && (Exclusive || this->dirty[replacedBlockId])) {
+        this->stats.numWriteback++;
+        CACHE_TRACE_EVENT(WRITEBACK, this->getLevel(), this->getAddrFromBlockId(replacedBlockId));
+        writeBlockToLowerLevel(replacedBlockId, cycles);
+        if (cycles != nullptr) this->stats.missCycles += this->missLatency;
+    }
+    if (HasVictim && !isWrite && this->valid[replacedBlockId]) {
+        this->insertToVictim(replacedBlockId);
+    }
+    this->valid[replacedBlockId] = true;
+    this->dirty[replacedBlockId] = blockDirty || isWrite;
+    this->tags[replacedBlockId] = this->getTag(addr);
+    this->policy->insert(replacedBlockId >> this->wayBits, replacedBlockId & (this->associativity - 1));
+    this->lastBlockId = replacedBlockId;
+    if (StoreData) {
+        uint8_t *blockData = this->getBlockData(replacedBlockId);
+        memcpy(blockData, this->fillBuffer, this->blockSize);
+        if (isWrite) {
+            memcpy(blockData + offset, buf, size); // change the data in cache
+        } else {
+            memcpy(buf, blockData + offset, size);
+        }
+    }
+}
+
+#define ACCESS_BLOCK_INSTANCES(wb, wa, ex) \
+    &Cache::accessBlock<wb, wa, ex, false, false>, &Cache::accessBlock<wb, wa, ex, false, true>, \
+    &Cache::accessBlock<wb, wa, ex, true, false>, &Cache::accessBlock<wb, wa, ex, true, true>
+
+#define FIND_IN_SET_INSTANCES(offsetBits) \
+    &Cache::findInSet<offsetBits, 1>, &Cache::findInSet<offsetBits, 2>, &Cache::findInSet<offsetBits, 4>, \
+    &Cache::findInSet<offsetBits, 8>, &Cache::findInSet<offsetBits, 16>, &Cache::findInSet<offsetBits, 32>
+
+// choose the specialized access and lookup for the current configuration,
+// called at construction and whenever a victim cache is attached
+void Cache::selectSpecialization() {
+    static const AccessFn accessFns[] = {
+        ACCESS_BLOCK_INSTANCES(false, false, false), ACCESS_BLOCK_INSTANCES(false, false, true),
+        ACCESS_BLOCK_INSTANCES(false, true, false), ACCESS_BLOCK_INSTANCES(false, true, true),
+        ACCESS_BLOCK_INSTANCES(true, false, false), ACCESS_BLOCK_INSTANCES(true, false, true),
+        ACCESS_BLOCK_INSTANCES(true, true, false), ACCESS_BLOCK_INSTANCES(true, true, true),
+    };
+    uint32_t accessId = (this->writeBack << 4) | (this->writeAllocate << 3) | (this->exclusive << 2) |
+                        ((this->victim != nullptr) << 1) | this->storeData;
+    this->accessFn = accessFns[accessId];
+
+    // block sizes 32 to 256 bytes, associativity 1 to 32
+    static const FindFn findFns[] = {
+        FIND_IN_SET_INSTANCES(5), FIND_IN_SET_INSTANCES(6), FIND_IN_SET_INSTANCES(7), FIND_IN_SET_INSTANCES(8),
+    };
+    this->findFn = &Cache::findInSetGeneric;
+    if (this->offsetBits >= 5 && this->offsetBits <= 8 && this->wayBits <= 5) {
+        this->findFn = findFns[(this->offsetBits - 5) * 6 + this->wayBits];
+    }
+}
+
+// move bytes to/from the next level as a single transaction per lower-level block
+void Cache::readFromLowerLevel(uint32_t addr, uint8_t *buf, uint32_t size, uint32_t *cycles) {
+    if (this->lowerCache == nullptr) {
+        if (this->missStream != nullptr) this->missStream->append(TraceBuffer::READ, addr, size);
+        if (this->storeData) this->memory->getBytesNoCache(addr, buf, size);
+    } else {
+        this->lowerCache->access(addr, size, false, buf, cycles);
+    }
+}
+
+void Cache::writeToLowerLevel(uint32_t addr, uint8_t *buf, uint32_t size, uint32_t *cycles) {
+    if (this->lowerCache == nullptr) {
+        if (this->missStream != nullptr) this->missStream->append(TraceBuffer::WRITE, addr, size);
+        if (this->storeData) this->memory->setBytesNoCache(addr, buf, size);
+    } else {
+        this->lowerCache->access(addr, size, true, buf, cycles);
+    }
+}
+
+void Cache::insertToVictim(uint32_t evictedBlockId) {
+    // find a free block in victim and replace it by the evicted block
+    Cache *v = this->victim;
+    uint32_t addr = this->getAddrFromBlockId(evictedBlockId);
+    int replaceIdx = -1;
+    for (uint32_t i = 0; i < v->associativity; i++) {
+        if (!v->valid[i]) {
+            replaceIdx = i;
+            break;
+        }
+    }
+    if (replaceIdx == -1) {
+        replaceIdx = v->policy->getVictim(0);
+    }
+    if (this->storeData) memcpy(v->getBlockData(replaceIdx), this->getBlockData(evictedBlockId), this->blockSize);
+    v->valid[replaceIdx] = true;
+    v->tags[replaceIdx] = v->getTag(addr);
+    v->policy->insert(0, replaceIdx);
+}
+
+uint32_t Cache::getAddrFromBlockId(uint32_t blockId) {
+    uint32_t tag = this->tags[blockId];
+    uint32_t index = blockId >> this->wayBits;
+    uint32_t address = (tag << (this->indexBits + this->offsetBits)) | (index << this->offsetBits);
+    return address;
+}
+
+// only valid when the cache stores data
+uint8_t *Cache::getBlockData(uint32_t blockId) {
+    return this->data + (size_t)blockId * this->blockSize;
+}
+
+void Cache::initializeCache() {
+    this->tags.assign(this->numBlocks, 0);
+    this->valid.assign(this->numBlocks, false);
+    this->dirty.assign(this->numBlocks, false);
+    this->lastBlockId = -1;
+    this->missStream = nullptr;
+    this->sampleBits = 0;
+    this->optPolicy = nullptr;
+    this->policy = ReplacementPolicy::create(ReplacementPolicy::LRU, this->numBlocks / this->associativity,
+                                             this->associativity);
+    this->data = nullptr;
+    this->fillBuffer = nullptr;
+    this->dataSize = 0;
+    if (this->storeData) {
+        this->dataSize = ((size_t)this->numBlocks + 1) * this->blockSize;
+        this->data = allocateArena(this->dataSize);
+        if (this->data == nullptr) {
+            fprintf(stderr, "Unable to allocate %zu bytes of cache data\n", this->dataSize);
+            exit(-1);
+        }
+        this->fillBuffer = this->getBlockData(this->numBlocks);
+    }
+    // std::cout << "-----initialization success-----" << std::endl;
+}
+
+// numReads read hits and numWrites write hits on the block of the last access,
+// as accessBlock counts them. Touching the block again leaves every policy in
+// the state of the first touch, so it is touched once
+void Cache::repeatHits(uint64_t numReads, uint64_t numWrites, uint32_t *cycles) {
+    uint32_t blockId = this->lastBlockId;
+    this->stats.numReadHit += numReads;
+    this->stats.numWriteHit += numWrites;
+    if (cycles != nullptr) this->stats.baseCycles += this->hitLatency * (numReads + numWrites);
+    this->policy->touch(blockId >> this->wayBits, blockId & (this->associativity - 1));
+    if (numWrites > 0) {
+        this->dirty[blockId] = true;
+        // written through to a memory that holds no data, see canRepeatHits()
+        if (!this->writeBack && cycles != nullptr) this->stats.missCycles += this->missLatency * numWrites;
+    }
+    if (this->sampleBits != 0) {
+        uint64_t *counts = &this->setCounts[3 * (size_t)(blockId >> this->wayBits)];
+        counts[0] += numReads + numWrites;
+        if (cycles != nullptr) {
+            counts[2] += this->hitLatency * (numReads + numWrites);
+            if (!this->writeBack) counts[2] += this->missLatency * numWrites;
+        }
+    }
+}
+
+void Cache::set_lower_cache(Cache *cache) {
+    this->lowerCache = cache;
+    cache->higherCache = this;
+    this->missLatency = cache->hitLatency;
+}
+
+void Cache::set_victim(Cache *victim) {
+    this->victim = victim;
+    this->selectSpecialization();
+}
+
+void Cache::set_replacement_policy(ReplacementPolicy::Policy policy, uint32_t seed) {
+    delete this->policy;
+    this->policy = ReplacementPolicy::create(policy, this->numBlocks / this->associativity, this->associativity, seed);
+    this->optPolicy = nullptr;
+}
+
+void Cache::set_next_use(const NextUseIndex *index) {
+    delete this->policy;
+    this->optPolicy = new OPTPolicy(this->numBlocks / this->associativity, this->associativity, index);
+    this->policy = this->optPolicy;
+}
+
+uint32_t Cache::findReplacedBlockId(uint32_t addr) {
+    uint32_t index = this->getIndex(addr);
+    uint32_t start = this->associativity * index;
+    uint32_t end = this->associativity * (index + 1);
+
+    // find invalid blocks
+    for (uint32_t i = start; i < end; i++) {
+        if (!this->valid[i]) {
+            return i;
+        }
+    }
+
+    // the set in cache is full, the replacement policy chooses the block to evict
+    uint32_t evictedBlockId = start + this->policy->getVictim(index);
+
+    if (!this->exclusive) {this->evictBlockFromHigherCaches(getAddrFromBlockId(evictedBlockId));}
+
+    return evictedBlockId;
+}
+
+void Cache::evictBlockFromHigherCaches(uint32_t addr) {
+    if (this->higherCache != nullptr) { 
+        uint32_t blockId = this->higherCache->findInCache(addr);
+        if (blockId != -1) {
+            // Recursive call to ensure the block is removed from all higher levels,
+            // the highest level goes first so its dirty data is merged downwards
+            this->higherCache->evictBlockFromHigherCaches(addr);
+            // Evict the block from the higher cache
+            this->higherCache->stats.numBackInvalidate++;
+            CACHE_TRACE_EVENT(BACK_INVALIDATE, this->higherCache->getLevel(), addr);
+            this->higherCache->evictBlock(blockId);
+        }
+    }
+}
+
+void Cache::evictBlock(uint32_t blockId) {
+    // Evicts the block at blockId from this cache
+    if (this->valid[blockId] && this->dirty[blockId]) {
+        uint32_t addr = this->getAddrFromBlockId(blockId);
+        if (this->lowerCache == nullptr) {
+            if (this->storeData) this->memory->setBytesNoCache(addr, this->getBlockData(blockId), this->blockSize);
+        } else {
+            // the lower level is evicting its copy, merge the dirty block into it before it is written back,
+            // the lower copy becomes dirty in timing-only mode too so its writeback is counted
+            int lowerBlockId = this->lowerCache->findInCache(addr);
+            if (lowerBlockId != -1) {
+                if (this->storeData) {
+                    uint8_t *dst = this->lowerCache->getBlockData(lowerBlockId) + this->lowerCache->getOffset(addr);
+                    memcpy(dst, this->getBlockData(blockId), this->blockSize);
+                }
+                this->lowerCache->dirty[lowerBlockId] = true;
+            }
+        }
+    }
+    // Invalidate the block
+    this->valid[blockId] = false;
+    this->dirty[blockId] = false;
+}
+
+// write the valid block at blockId back to the next level, at its own address
+void Cache::writeBlockToLowerLevel(uint32_t blockId, uint32_t *cycles) {
+    uint32_t addr = this->getAddrFromBlockId(blockId);
+    if (this->exclusive) {
+        Cache *lower = this->lowerCache;
+        if (lower != nullptr) {
+            uint32_t replacedBlockId = lower->findReplacedBlockId(addr);
+            if (lower->valid[replacedBlockId]) {
+                lower->stats.numWriteback++;
+                CACHE_TRACE_EVENT(WRITEBACK, lower->getLevel(), lower->getAddrFromBlockId(replacedBlockId));
+                lower->writeBlockToLowerLevel(replacedBlockId, cycles);
+                if (cycles != nullptr) this->stats.missCycles += this->missLatency;
+            }
+            // replace the blocks[blockId] in lower cache by the block from upper cache
+            if (this->storeData) memcpy(lower->getBlockData(replacedBlockId), this->getBlockData(blockId), this->blockSize);
+            lower->valid[replacedBlockId] = true;
+            lower->dirty[replacedBlockId] = this->dirty[blockId];
+            lower->tags[replacedBlockId] = lower->getTag(addr);
+            lower->policy->insert(replacedBlockId / lower->associativity, replacedBlockId % lower->associativity);
+        } else if (this->dirty[blockId] && this->storeData) {
+            // No lower cache and block is dirty, write back to memory
+            this->memory->setBytesNoCache(addr, this->getBlockData(blockId), this->blockSize);
+        }
+    } else {
+        this->writeToLowerLevel(addr, this->storeData ? this->getBlockData(blockId) : nullptr, this->blockSize, cycles);
+    }
+}
+
+// read the block containing addr from the lower levels into dst, returns whether it is dirty
+bool Cache::getBlockFromLowerLevel(uint32_t addr, uint8_t *dst, uint32_t *cycles) {
+    uint32_t blockBegin = getMemBegin(addr);
+    if (this->exclusive) {
+        Cache *current = this->lowerCache;
+        while (current != nullptr) {
+            if (cycles != nullptr) this->stats.missCycles += current->hitLatency;
+
+            int blockId = current->findInCache(addr);
+            if (blockId != -1) {
+                this->stats.numExclusiveSwap++;
+                bool blockDirty = current->dirty[blockId];
+                if (this->storeData) memcpy(dst, current->getBlockData(blockId), this->blockSize);
+                current->valid[blockId] = false;
+                current->dirty[blockId] = false;
+                return blockDirty;
+            } else {
+                current = current->lowerCache;
+            }
+        }
+        if (this->storeData) this->memory->getBytesNoCache(blockBegin, dst, this->blockSize);
+    } else {
+        // inclusive cache, get block recursively
+        this->readFromLowerLevel(blockBegin, dst, this->blockSize, cycles);
+    }
+    return false;
+}
+
+// get the beginning address of the block of addr in memory
+uint32_t Cache::getMemBegin(uint32_t addr) {
+    return addr & ~(this->blockSize - 1);
+    // uint32_t offsetDigit = log2(this->blockSize);
+    // uint32_t mask = ~(1 << offsetDigit) - 1; // 11111100000
+    // return addr & mask;
+}
+
+// find the way of a set holding tag, or -1
+static inline int findWay(const uint32_t *setTags, const uint8_t *setValid, uint32_t ways, uint32_t tag) {
+    uint32_t i = 0;
+#if defined(__AVX2__)
+    // compare 8 ways at a time, a set bit in the mask is a way whose tag matches
+    __m256i key8 = _mm256_set1_epi32(tag);
+    for (; i + 8 <= ways; i += 8) {
+        __m256i t = _mm256_loadu_si256((const __m256i *)(setTags + i));
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(t, key8)));
+        for (; mask != 0; mask &= mask - 1) {
+            uint32_t way = i + __builtin_ctz(mask);
+            if (setValid[way]) return way;
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i key4 = _mm_set1_epi32(tag);
+    for (; i + 4 <= ways; i += 4) {
+        __m128i t = _mm_loadu_si128((const __m128i *)(setTags + i));
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, key4)));
+        for (; mask != 0; mask &= mask - 1) {
+            uint32_t way = i + __builtin_ctz(mask);
+            if (setValid[way]) return way;
+        }
+    }
+#endif
+    // remaining ways, or all of them without SIMD support
+    for (; i < ways; i++) {
+        if (setValid[i] && setTags[i] == tag) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// if the block is in the cache, return the block number, otherwise return -1
+template <uint32_t OffsetBits, uint32_t Ways>
+int Cache::findInSet(uint32_t addr) {
+    uint32_t index = (addr >> OffsetBits) & ((1u << this->indexBits) - 1);
+    uint32_t tag = addr >> (OffsetBits + this->indexBits);
+    uint32_t start = index * Ways;
+    int way = findWay(&this->tags[start], &this->valid[start], Ways, tag);
+    return way == -1 ? -1 : (int)(start + way);
+}
+
+int Cache::findInSetGeneric(uint32_t addr) {
+    uint32_t start = this->getIndex(addr) << this->wayBits;
+    int way = findWay(&this->tags[start], &this->valid[start], this->associativity, this->getTag(addr));
+    return way == -1 ? -1 : (int)(start + way);
+}
+
+uint64_t Cache::get_total_cycles() {
+    uint64_t result = this->stats.baseCycles + this->stats.missCycles;
+    Cache *current = this->lowerCache;
+    while (current != nullptr) {
+        result += current->stats.missCycles;
+        current = current->lowerCache;
+    }
+    return result;
+}
+
+void Cache::printStatistics(const char *name) {
+    this->stats.print(name);
+}
+
+CacheStats::CacheStats() {
+    memset(this, 0, sizeof(CacheStats));
+}
+
+CacheStats CacheStats::operator-(const CacheStats &other) const {
+    CacheStats result;
+    const uint64_t *a = (const uint64_t *)this;
+    const uint64_t *b = (const uint64_t *)&other;
+    uint64_t *r = (uint64_t *)&result;
+    for (size_t i = 0; i < sizeof(CacheStats) / sizeof(uint64_t); i++) {
+        r[i] = a[i] - b[i];
+    }
+    return result;
+}
+
+CacheStats &CacheStats::operator+=(const CacheStats &other) {
+    const uint64_t *b = (const uint64_t *)&other;
+    uint64_t *r = (uint64_t *)this;
+    for (size_t i = 0; i < sizeof(CacheStats) / sizeof(uint64_t); i++) {
+        r[i] += b[i];
+    }
+    return *this;
+}
+
+void CacheStats::print(const char *name) const {
+    printf("---------- %s ----------\n", name);
+    printf("Accesses: %llu  Hits: %llu  Misses: %llu  Miss Rate: %.4f\n", (unsigned long long)this->numAccesses(),
+           (unsigned long long)this->numHit(), (unsigned long long)this->numMiss(), this->missRate());
+    printf("Read Hits: %llu  Read Misses: %llu  Write Hits: %llu  Write Misses: %llu\n",
+           (unsigned long long)this->numReadHit, (unsigned long long)this->numReadMiss,
+           (unsigned long long)this->numWriteHit, (unsigned long long)this->numWriteMiss);
+    printf("Fills: %llu  Writebacks: %llu  Back Invalidations: %llu  Victim Hits: %llu  Exclusive Swaps: %llu\n",
+           (unsigned long long)this->numFill, (unsigned long long)this->numWriteback,
+           (unsigned long long)this->numBackInvalidate, (unsigned long long)this->numVictimHit,
+           (unsigned long long)this->numExclusiveSwap);
+    printf("Base Cycles: %llu  Miss Cycles: %llu\n", (unsigned long long)this->baseCycles,
+           (unsigned long long)this->missCycles);
+}
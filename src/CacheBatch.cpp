@@ -0,0 +1,118 @@
+#include <unistd.h>
+#include "CacheBatch.h"
+
+const size_t CacheBatch::DEFAULT_SIZE;
+
+namespace {
+
+// 5 bytes per access in a TraceBuffer
+const size_t BYTES_PER_RECORD = 5;
+const long DEFAULT_L2_SIZE = 256 * 1024;
+
+}
+
+CacheBatch::CacheBatch(size_t chunkLength) {
+    if (chunkLength == 0) {
+        long l2Size = -1;
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+        l2Size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        if (l2Size <= 0) l2Size = DEFAULT_L2_SIZE;
+        // the other half is left to the state of the simulated caches
+        chunkLength = (size_t)l2Size / 2 / BYTES_PER_RECORD;
+    }
+    this->chunkLength = chunkLength;
+    this->setRatio = 1;
+    this->traceLength = 0;
+    this->cycles = 0;
+}
+
+CacheBatch::~CacheBatch() {
+    for (RepeatFilter *filter : this->filters) delete filter;
+    for (RepeatFilter *filter : this->warmFilters) delete filter;
+    for (Cache *cache : this->caches) delete cache;
+    for (MemoryManager *memory : this->memories) delete memory;
+}
+
+void CacheBatch::setSampling(const TimeSampling &timeSampling, uint32_t setRatio) {
+    this->timeSampling = timeSampling;
+    this->setRatio = setRatio;
+}
+
+size_t CacheBatch::add(uint32_t cacheSize, uint32_t blockSize, uint32_t associativity, bool writeBack,
+                       bool writeAllocate, ReplacementPolicy::Policy policy, bool filterRepeats) {
+    MemoryManager *memory = new MemoryManager(false);
+    Cache *cache = new Cache(memory, 1, cacheSize, blockSize, associativity, writeBack, writeAllocate);
+    cache->set_replacement_policy(policy);
+    if (this->setRatio > 1) cache->setSetSampling(this->setRatio);
+    this->memories.push_back(memory);
+    this->caches.push_back(cache);
+    this->filters.push_back(new RepeatFilter(cache, filterRepeats));
+    this->warmFilters.push_back(new RepeatFilter(cache, true));
+    this->samplers.push_back(TimeSampler());
+    return this->caches.size() - 1;
+}
+
+void CacheBatch::run(const TraceBuffer &trace) {
+    this->traceLength = trace.size();
+    if (this->timeSampling.enabled()) {
+        const TimeSampling &sampling = this->timeSampling;
+        for (uint64_t k = 0; k < sampling.numSamples(trace.size()); k++) {
+            size_t unitBegin = sampling.unitBegin(k);
+            for (size_t c = 0; c < this->caches.size(); c++) {
+                if (sampling.functionalWarming) this->warm(c, trace, sampling.skippedBegin(k), sampling.warmupBegin(k));
+                this->replay(c, trace, sampling.warmupBegin(k), unitBegin);
+                this->filters[c]->flush();
+                this->samplers[c].beginUnit(this->caches[c]->stats);
+                this->replay(c, trace, unitBegin, unitBegin + sampling.unit);
+                this->filters[c]->flush();
+                this->samplers[c].endUnit(this->caches[c]->stats, sampling.unit);
+            }
+        }
+        return;
+    }
+    for (size_t begin = 0; begin < trace.size(); begin += this->chunkLength) {
+        size_t end = begin + this->chunkLength < trace.size() ? begin + this->chunkLength : trace.size();
+        for (size_t c = 0; c < this->caches.size(); c++) {
+            this->replay(c, trace, begin, end);
+        }
+    }
+    for (RepeatFilter *filter : this->filters) filter->flush();
+}
+
+void CacheBatch::getEstimates(size_t i, Estimate *missRate, Estimate *cpi) {
+    if (this->timeSampling.enabled()) {
+        this->samplers[i].estimate(this->timeSampling, this->traceLength, missRate, cpi);
+    } else {
+        estimateSetSampled(this->caches[i], this->traceLength, missRate, cpi);
+    }
+}
+
+void CacheBatch::replay(size_t c, const TraceBuffer &trace, size_t begin, size_t end) {
+    MemoryManager *memory = this->memories[c];
+    RepeatFilter *filter = this->filters[c];
+    uint64_t data = 6;
+    for (size_t i = begin; i < end; i++) {
+        uint32_t address = trace.getAddress(i);
+        if (!memory->isPageExist(address)) {
+            memory->addPage(address);
+        }
+        TraceBuffer::Operation operation = trace.getOperation(i);
+        if (operation == TraceBuffer::OTHER) continue;
+        filter->access(address, trace.getSize(i), operation == TraceBuffer::WRITE, (uint8_t *)&data, &this->cycles);
+    }
+}
+
+// functional warming: the records only update the tags and the replacement state, without
+// the page bookkeeping and the cycles, and the runs on one block are applied in bulk.
+// The statistics they add are left out, the samplers only take the counts of the units
+void CacheBatch::warm(size_t c, const TraceBuffer &trace, size_t begin, size_t end) {
+    RepeatFilter *filter = this->warmFilters[c];
+    uint64_t data = 6;
+    for (size_t i = begin; i < end; i++) {
+        TraceBuffer::Operation operation = trace.getOperation(i);
+        if (operation == TraceBuffer::OTHER) continue;
+        filter->access(trace.getAddress(i), trace.getSize(i), operation == TraceBuffer::WRITE, (uint8_t *)&data);
+    }
+    filter->flush();
+}
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#include "CacheTrace.h"
+
+const uint32_t CacheTrace::CAPACITY;
+
+namespace {
+
+struct EventRing
+{
+    CacheEvent events[CacheTrace::CAPACITY];
+    uint64_t numEvents = 0;
+    uint16_t thread = 0;
+};
+
+// Rings are owned by the registry and outlive their threads, so events of
+// finished worker threads are still dumped
+std::mutex registryMutex;
+std::vector<EventRing *> &registry() {
+    static std::vector<EventRing *> rings;
+    return rings;
+}
+
+EventRing *threadRing() {
+    static thread_local EventRing *ring = nullptr;
+    if (ring == nullptr) {
+        ring = new EventRing();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        ring->thread = (uint16_t)registry().size();
+        registry().push_back(ring);
+    }
+    return ring;
+}
+
+}
+
+void CacheTrace::record(CacheEvent::Type type, uint32_t level, uint32_t addr) {
+    EventRing *ring = threadRing();
+    CacheEvent &event = ring->events[ring->numEvents & (CAPACITY - 1)];
+    event.seq = ring->numEvents++;
+    event.addr = addr;
+    event.type = type;
+    event.level = (uint8_t)level;
+    event.thread = ring->thread;
+}
+
+bool CacheTrace::dump(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint32_t numEvents = 0;
+    for (EventRing *ring : registry()) {
+        numEvents += ring->numEvents < CAPACITY ? (uint32_t)ring->numEvents : CAPACITY;
+    }
+    char magic[8] = "CTRACE1";
+    uint32_t eventSize = sizeof(CacheEvent);
+    fwrite(magic, 1, sizeof(magic), file);
+    fwrite(&eventSize, sizeof(eventSize), 1, file);
+    fwrite(&numEvents, sizeof(numEvents), 1, file);
+    for (EventRing *ring : registry()) {
+        // oldest event first, the ring has wrapped if more than CAPACITY were recorded
+        uint64_t first = ring->numEvents < CAPACITY ? 0 : ring->numEvents - CAPACITY;
+        for (uint64_t i = first; i < ring->numEvents; i++) {
+            fwrite(&ring->events[i & (CAPACITY - 1)], sizeof(CacheEvent), 1, file);
+        }
+    }
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
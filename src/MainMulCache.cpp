@@ -1,146 +1,704 @@
 /*
- * Main entrance of the single-level cache simulator.
- * ./SinCacheSimulator path
+ * Main entrance of the multi-level cache simulator.
+ * ./MulCacheSimulator path [-r policy[,policy,policy]] [-t file] [-p chunks] [-w warmup] [-e] [-S] [-f format] [-R] [-L] [-l file] [-T sampling]
  */
 
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
 #include <fstream>
+#include <vector>
 #include "Cache.h"
 #include "MemoryManager.h"
+#include "Parallel.h"
+#include "RepeatFilter.h"
+#include "Sampling.h"
+#include "TraceDecoder.h"
+#include "TracePipeline.h"
+#include "TraceReader.h"
+
+// a cache hierarchy under test, the trace accesses levels[0] through the filter
+struct Hierarchy
+{
+    MemoryManager *memory;
+    std::vector<Cache *> levels;
+    Cache *victim;
+    RepeatFilter *filter;
+};
 
 bool parseParameters(int argc, char **argv);
-void simulate_single(Cache *cache, MemoryManager *memory, std::ofstream &csvFile);
-void simulate_multi(Cache *cache1, Cache *cache2, Cache *cache3, MemoryManager *memory, std::ofstream &csvFile);
+void printUsage();
+void setPolicies(Cache *cache1, Cache *cache2, Cache *cache3);
+Hierarchy buildSingleLevel();
+Hierarchy buildInclusive();
+Hierarchy buildExclusive();
+Hierarchy buildInclusiveVictim();
+void deleteHierarchy(Hierarchy &hierarchy);
+void accessHierarchy(Hierarchy &hierarchy, uint32_t address, uint32_t size, TraceBuffer::Operation operation,
+                     uint32_t *cycles);
+void replay(Hierarchy &hierarchy, size_t begin, size_t end);
+void warm(RepeatFilter &filter, size_t begin, size_t end);
+bool simulateStreamed();
+std::vector<CacheStats> getStats(const Hierarchy &hierarchy);
+std::vector<CacheStats> simulate(Hierarchy (*build)());
+std::vector<CacheStats> simulateSliced(Hierarchy (*build)());
+std::vector<CacheStats> simulateTimeSampled(Hierarchy (*build)());
+void reportError(const std::vector<CacheStats> &sliced, const std::vector<CacheStats> &serial, uint32_t numLevels);
+void writeResult(const std::vector<CacheStats> &stats, uint32_t numLevels, std::ofstream &csvFile);
 void compare1(std::ofstream &csvFile);
 void compare2(std::ofstream &csvFile);
 void compare3(std::ofstream &csvFile);
+bool captureMissStream(TraceBuffer &stream, CacheStats &l1Stats);
+void sweepLowerLevels(const TraceBuffer &stream, const CacheStats &l1Stats);
+
+// hit latencies of the levels of every hierarchy, in cycles
+const uint32_t L1_LATENCY = 1;
+const uint32_t L2_LATENCY = 8;
+const uint32_t L3_LATENCY = 20;
+const uint32_t VICTIM_LATENCY = 2;
 
-const char *traceFilePath;
+const char *traceFilePath = nullptr;
+TraceReader::Format traceFormat = TraceReader::AUTO;
+TraceBuffer trace; // loaded once, replayed by every hierarchy
+uint64_t traceLength = 0; // records in the trace, the CPI is per record
+const char *eventDumpPath = nullptr; // binary dump of the traced cache events
+// replacement policy of L1, L2 and L3
+ReplacementPolicy::Policy policies[3] = {ReplacementPolicy::LRU, ReplacementPolicy::LRU, ReplacementPolicy::LRU};
+// time-sliced simulation: the trace is cut into numChunks pieces simulated in
+// parallel, each from a cold hierarchy warmed up by the last warmup accesses
+// before it, at most one chunk and a quarter of a chunk unless -w says otherwise
+const uint64_t DEFAULT_WARMUP = UINT64_MAX;
+const uint64_t WARMUP_FRACTION = 4;
+uint32_t numChunks = 1;
+uint64_t warmup = DEFAULT_WARMUP;
+bool reportSliceError = false;
+// -S: the trace is streamed once through a reader thread into all the
+// hierarchies at the same time, instead of being loaded
+bool streaming = false;
+Hierarchy (*const streamedBuilds[])() = {buildSingleLevel, buildInclusive, buildExclusive, buildInclusiveVictim};
+const size_t NUM_STREAMED = sizeof(streamedBuilds) / sizeof(streamedBuilds[0]);
+std::vector<CacheStats> streamedStats[NUM_STREAMED];
+bool filterRepeats = false; // -R, runs of accesses to the same L1 block are applied as bulk hits
+// -L: the L1 of the hierarchies is simulated once, and the reads and writes
+// it makes below are replayed into a sweep of L2 and L3 configurations
+bool lowerSweep = false;
+const char *missStreamPath = nullptr; // -l, the captured stream is also written there as a binary trace
+// -T: only sampled windows of the trace are simulated, the results are the
+// estimates of the last simulate() call
+TimeSampling timeSampling;
+Estimate sampledMissRate; // of L1
+Estimate sampledCpi;
 
 int main(int argc, char **argv) {
     if (!parseParameters(argc, argv)) {
+        printUsage();
+        return -1;
+    }
+    if (lowerSweep) {
+        TraceBuffer stream;
+        CacheStats l1Stats;
+        if (!captureMissStream(stream, l1Stats)) {
+            printf("Unable to open file %s\n", traceFilePath);
+            return -1;
+        }
+        sweepLowerLevels(stream, l1Stats);
+        return 0;
+    }
+    if (streaming ? !simulateStreamed() : !trace.load(traceFilePath, traceFormat)) {
+        printf("Unable to open file %s\n", traceFilePath);
         return -1;
     }
+    if (!streaming) traceLength = trace.size();
+    if (numChunks > 1) {
+        // a warmup longer than a chunk replays overlapping prefixes and takes away the speedup
+        uint64_t chunkLength = trace.size() / numChunks;
+        if (warmup == DEFAULT_WARMUP) {
+            warmup = chunkLength / WARMUP_FRACTION;
+        } else if (warmup > chunkLength) {
+            printf("The warmup of %llu accesses is longer than a chunk, using %llu\n", (unsigned long long)warmup,
+                   (unsigned long long)chunkLength);
+            warmup = chunkLength;
+        }
+    }
     std::ofstream csvFile("./src/analysis_p2.csv");
     compare1(csvFile);
     compare2(csvFile);
     compare3(csvFile);
     csvFile.close();
+    if (eventDumpPath != nullptr) {
+#ifndef CACHE_TRACE
+        printf("Cache event tracing is not compiled in, build with -DCACHE_TRACE\n");
+#endif
+        if (!CacheTrace::dump(eventDumpPath)) {
+            printf("Unable to write %s\n", eventDumpPath);
+            return -1;
+        }
+    }
     return 0;
 }
 
 void compare1(std::ofstream &csvFile) {
-    MemoryManager *memory_single = new MemoryManager();
-    Cache *cache = new Cache(memory_single, 1, 16 * 1024, 64, 1, true, true);
-    simulate_single(cache, memory_single, csvFile);
+    csvFile << "single-level cache:" << std::endl;
+    writeResult(simulate(buildSingleLevel), 1, csvFile);
     csvFile << std::endl;
 
     csvFile << "inclusive three-level cache without victim:" << std::endl;
-    MemoryManager *memory_mul = new MemoryManager();
-    Cache *cache1 = new Cache(memory_mul, 1, 16 * 1024, 64, 1, true, true);
-    Cache *cache2 = new Cache(memory_mul, 8, 128 * 1024, 64, 8, true, true);
-    Cache *cache3 = new Cache(memory_mul, 20, 2 * 1024 * 1024, 64, 16, true, true);
-    cache1->set_lower_cache(cache2);
-    cache2->set_lower_cache(cache3);
-    simulate_multi(cache1, cache2, cache3, memory_mul, csvFile);
+    writeResult(simulate(buildInclusive), 3, csvFile);
     csvFile << std::endl;
 }
 
 void compare2(std::ofstream &csvFile) {
     csvFile << "exclusive three-level cache without victim:" << std::endl;
-    MemoryManager *memory_exclusive = new MemoryManager();
-    Cache *cache1_exclusive = new Cache(memory_exclusive, 1, 16 * 1024, 64, 1, true, true, true);
-    Cache *cache2_exclusive = new Cache(memory_exclusive, 8, 128 * 1024, 64, 8, true, true, true);
-    Cache *cache3_exclusive = new Cache(memory_exclusive, 20, 2 * 1024 * 1024, 64, 16, true, true, true);
-    cache1_exclusive->set_lower_cache(cache2_exclusive);
-    cache2_exclusive->set_lower_cache(cache3_exclusive);
-    simulate_multi(cache1_exclusive, cache2_exclusive, cache3_exclusive, memory_exclusive, csvFile);
+    writeResult(simulate(buildExclusive), 3, csvFile);
     csvFile << std::endl;
 }
 
 void compare3(std::ofstream &csvFile) {
     csvFile << "inclusive three-level cache with victim:" << std::endl;
-    MemoryManager *memory_victim = new MemoryManager();
-    Cache *cache1 = new Cache(memory_victim, 1, 16 * 1024, 64, 1, true, true);
-    Cache *cache2 = new Cache(memory_victim, 8, 128 * 1024, 64, 8, true, true);
-    Cache *cache3 = new Cache(memory_victim, 20, 2 * 1024 * 1024, 64, 16, true, true);
-    Cache *victim = new Cache(memory_victim, 2, 8 * 64, 64, 8, true, true);
+    writeResult(simulate(buildInclusiveVictim), 3, csvFile);
+    csvFile << std::endl;
+}
+
+// the trace carries no data values, so every hierarchy is timing only
+Hierarchy buildSingleLevel() {
+    Hierarchy hierarchy;
+    hierarchy.memory = new MemoryManager(false);
+    Cache *cache = new Cache(hierarchy.memory, L1_LATENCY, 16 * 1024, 64, 1, true, true);
+    cache->set_replacement_policy(policies[0]);
+    hierarchy.levels.push_back(cache);
+    hierarchy.victim = nullptr;
+    hierarchy.filter = new RepeatFilter(cache, filterRepeats);
+    return hierarchy;
+}
+
+Hierarchy buildInclusive() {
+    Hierarchy hierarchy;
+    hierarchy.memory = new MemoryManager(false);
+    Cache *cache1 = new Cache(hierarchy.memory, L1_LATENCY, 16 * 1024, 64, 1, true, true);
+    Cache *cache2 = new Cache(hierarchy.memory, L2_LATENCY, 128 * 1024, 64, 8, true, true);
+    Cache *cache3 = new Cache(hierarchy.memory, L3_LATENCY, 2 * 1024 * 1024, 64, 16, true, true);
     cache1->set_lower_cache(cache2);
-    cache1->set_victim(victim);
     cache2->set_lower_cache(cache3);
-    simulate_multi(cache1, cache2, cache3, memory_victim, csvFile);
-    csvFile << std::endl;
+    setPolicies(cache1, cache2, cache3);
+    hierarchy.levels = {cache1, cache2, cache3};
+    hierarchy.victim = nullptr;
+    hierarchy.filter = new RepeatFilter(cache1, filterRepeats);
+    return hierarchy;
 }
 
-void simulate_multi(Cache *cache1, Cache *cache2, Cache *cache3, MemoryManager *memory, std::ofstream &csvFile) {
-    // open the trace file
-    std::ifstream traceFile(traceFilePath);
-    if (!traceFile.is_open()) {
-        printf("Unable to open file %s\n", traceFilePath);
-        exit(-1);
+Hierarchy buildExclusive() {
+    Hierarchy hierarchy;
+    hierarchy.memory = new MemoryManager(false);
+    Cache *cache1_exclusive = new Cache(hierarchy.memory, L1_LATENCY, 16 * 1024, 64, 1, true, true, true);
+    Cache *cache2_exclusive = new Cache(hierarchy.memory, L2_LATENCY, 128 * 1024, 64, 8, true, true, true);
+    Cache *cache3_exclusive = new Cache(hierarchy.memory, L3_LATENCY, 2 * 1024 * 1024, 64, 16, true, true, true);
+    cache1_exclusive->set_lower_cache(cache2_exclusive);
+    cache2_exclusive->set_lower_cache(cache3_exclusive);
+    setPolicies(cache1_exclusive, cache2_exclusive, cache3_exclusive);
+    hierarchy.levels = {cache1_exclusive, cache2_exclusive, cache3_exclusive};
+    hierarchy.victim = nullptr;
+    hierarchy.filter = new RepeatFilter(cache1_exclusive, filterRepeats);
+    return hierarchy;
+}
+
+Hierarchy buildInclusiveVictim() {
+    Hierarchy hierarchy = buildInclusive();
+    hierarchy.victim = new Cache(hierarchy.memory, VICTIM_LATENCY, 8 * 64, 64, 8, true, true);
+    hierarchy.levels[0]->set_victim(hierarchy.victim);
+    return hierarchy;
+}
+
+void deleteHierarchy(Hierarchy &hierarchy) {
+    delete hierarchy.filter;
+    for (Cache *cache : hierarchy.levels) delete cache;
+    delete hierarchy.victim;
+    delete hierarchy.memory;
+    hierarchy.levels.clear();
+    hierarchy.victim = nullptr;
+    hierarchy.memory = nullptr;
+    hierarchy.filter = nullptr;
+}
+
+void setPolicies(Cache *cache1, Cache *cache2, Cache *cache3) {
+    cache1->set_replacement_policy(policies[0]);
+    cache2->set_replacement_policy(policies[1]);
+    cache3->set_replacement_policy(policies[2]);
+}
+
+inline void accessHierarchy(Hierarchy &hierarchy, uint32_t address, uint32_t size, TraceBuffer::Operation operation,
+                            uint32_t *cycles) {
+    if (!hierarchy.memory->isPageExist(address)) {
+        hierarchy.memory->addPage(address);
+    }
+    uint64_t data = 6;
+    if (operation == TraceBuffer::READ) {
+        hierarchy.filter->access(address, size, false, (uint8_t *)&data, cycles);
+    } else if (operation == TraceBuffer::WRITE) {
+        hierarchy.filter->access(address, size, true, (uint8_t *)&data, cycles);
     }
+}
 
-    char operation;
-    uint32_t address;
+void replay(Hierarchy &hierarchy, size_t begin, size_t end) {
     uint32_t cycles = 0;
-    int count = 0;
-    while (traceFile >> operation >> std::hex >> address) {
-        count++;
-        if (!memory->isPageExist(address)) {
-            memory->addPage(address);
+    for (size_t i = begin; i < end; i++) {
+        accessHierarchy(hierarchy, trace.getAddress(i), trace.getSize(i), trace.getOperation(i), &cycles);
+    }
+}
+
+// functional warming of a hierarchy through a filter on its L1, without the page bookkeeping and the cycles
+void warm(RepeatFilter &filter, size_t begin, size_t end) {
+    uint64_t data = 6;
+    for (size_t i = begin; i < end; i++) {
+        TraceBuffer::Operation operation = trace.getOperation(i);
+        if (operation == TraceBuffer::OTHER) continue;
+        filter.access(trace.getAddress(i), trace.getSize(i), operation == TraceBuffer::WRITE, (uint8_t *)&data);
+    }
+    filter.flush();
+}
+
+// one pass over the streamed trace, every batch goes through all the
+// hierarchies before the reader thread gets it back
+bool simulateStreamed() {
+    TracePipeline pipeline;
+    if (!pipeline.open(traceFilePath, traceFormat)) {
+        return false;
+    }
+    Hierarchy hierarchies[NUM_STREAMED];
+    for (size_t h = 0; h < NUM_STREAMED; h++) hierarchies[h] = streamedBuilds[h]();
+    uint32_t cycles = 0;
+    size_t count;
+    while (const TraceRecord *records = pipeline.nextBatch(&count)) {
+        for (size_t h = 0; h < NUM_STREAMED; h++) {
+            for (size_t i = 0; i < count; i++) {
+                accessHierarchy(hierarchies[h], records[i].address, records[i].size,
+                                (TraceBuffer::Operation)records[i].operation, &cycles);
+            }
         }
-        if (operation == 'r') {
-            uint8_t result = cache1->get_byte(address, &cycles);
-            // std::cout << result << std::endl;
-        } else if (operation == 'w') {
-            cache1->set_byte(address, 6, &cycles);
+    }
+    for (size_t h = 0; h < NUM_STREAMED; h++) {
+        streamedStats[h] = getStats(hierarchies[h]);
+        deleteHierarchy(hierarchies[h]);
+    }
+    traceLength = pipeline.getNumRecords();
+    return true;
+}
+
+// the L1 of the hierarchies alone, its miss cycles count the transfers to the
+// lower level, which differ in latency between configurations
+bool captureMissStream(TraceBuffer &stream, CacheStats &l1Stats) {
+    Hierarchy l1 = buildSingleLevel();
+    l1.levels[0]->missLatency = 1;
+    l1.levels[0]->set_miss_stream(&stream);
+    if (streaming) {
+        TracePipeline pipeline;
+        if (!pipeline.open(traceFilePath, traceFormat)) {
+            deleteHierarchy(l1);
+            return false;
+        }
+        uint32_t cycles = 0;
+        size_t count;
+        while (const TraceRecord *records = pipeline.nextBatch(&count)) {
+            for (size_t i = 0; i < count; i++) {
+                accessHierarchy(l1, records[i].address, records[i].size, (TraceBuffer::Operation)records[i].operation,
+                                &cycles);
+            }
+        }
+        traceLength = pipeline.getNumRecords();
+    } else {
+        if (!trace.load(traceFilePath, traceFormat)) {
+            deleteHierarchy(l1);
+            return false;
         }
+        replay(l1, 0, trace.size());
+        traceLength = trace.size();
     }
-    // uint32_t totalCycles = cache1->baseCycles + cache1->missCycles + cache2->missCycles + cache3->missCycles;
-    uint32_t totalCycles = cache1->get_total_cycles();
-    float avgCycles = (float )totalCycles / count;
-    csvFile << "totalCycles: " << totalCycles << "  "
-        << "average cycles: " << avgCycles << std::endl;
+    l1Stats = getStats(l1)[0];
+    deleteHierarchy(l1);
+    printf("L1 miss stream: %llu accesses, %.2f%% of the %llu of the trace\n", (unsigned long long)stream.size(),
+           traceLength == 0 ? 0.0 : 100.0 * stream.size() / traceLength, (unsigned long long)traceLength);
+    if (missStreamPath != nullptr) {
+        TraceWriter writer;
+        bool ok = writer.open(missStreamPath);
+        for (size_t i = 0; ok && i < stream.size(); i++) {
+            writer.write(stream.getOperation(i) == TraceBuffer::WRITE ? 'w' : 'r', stream.getAddress(i),
+                         stream.getSize(i));
+        }
+        if (!writer.close() || !ok) printf("Unable to write %s\n", missStreamPath);
+    }
+    return true;
 }
 
-void simulate_single(Cache *cache, MemoryManager *memory, std::ofstream &csvFile) {
-    // open the trace file
-    std::ifstream traceFile(traceFilePath);
-    if (!traceFile.is_open()) {
-        printf("Unable to open file %s\n", traceFilePath);
-        exit(-1);
+// one L2 and L3 configuration of the sweep, below the L1 of buildInclusive
+struct LowerConfig
+{
+    uint32_t l2Size;
+    uint32_t l2Ways;
+    uint32_t l3Size;
+    uint32_t l3Ways;
+    uint32_t blockSize;
+    CacheStats l2Stats;
+    CacheStats l3Stats;
+};
+
+// L2 and L3 are inclusive with the latencies of buildInclusive. Their blocks are at least as large as
+// those of L1, so an access of the stream, whose size is rounded down, stays within one block like the
+// original. The result is exact as long as the full hierarchy back-invalidates nothing in L1, -e checks it
+void sweepLowerLevels(const TraceBuffer &stream, const CacheStats &l1Stats) {
+    std::vector<LowerConfig> configs;
+    for (uint32_t blockSize = 64; blockSize <= 128; blockSize *= 2) {
+        for (uint32_t l2Size = 64 * 1024; l2Size <= 512 * 1024; l2Size *= 2) {
+            for (uint32_t l2Ways = 4; l2Ways <= 16; l2Ways *= 2) {
+                for (uint32_t l3Size = 1024 * 1024; l3Size <= 4 * 1024 * 1024; l3Size *= 2) {
+                    for (uint32_t l3Ways = 8; l3Ways <= 16; l3Ways *= 2) {
+                        LowerConfig config;
+                        config.l2Size = l2Size;
+                        config.l2Ways = l2Ways;
+                        config.l3Size = l3Size;
+                        config.l3Ways = l3Ways;
+                        config.blockSize = blockSize;
+                        configs.push_back(config);
+                    }
+                }
+            }
+        }
     }
+    parallelFor(configs.size(), defaultNumThreads(), [&](size_t c) {
+        LowerConfig &config = configs[c];
+        MemoryManager memory(false);
+        Cache cache2(&memory, L2_LATENCY, config.l2Size, config.blockSize, config.l2Ways, true, true);
+        Cache cache3(&memory, L3_LATENCY, config.l3Size, config.blockSize, config.l3Ways, true, true);
+        cache2.set_lower_cache(&cache3);
+        cache2.set_replacement_policy(policies[1]);
+        cache3.set_replacement_policy(policies[2]);
+        uint32_t cycles = 0;
+        uint64_t data = 6;
+        for (size_t i = 0; i < stream.size(); i++) {
+            cache2.access(stream.getAddress(i), stream.getSize(i), stream.getOperation(i) == TraceBuffer::WRITE,
+                          (uint8_t *)&data, &cycles);
+        }
+        config.l2Stats = cache2.stats;
+        config.l3Stats = cache3.stats;
+    });
 
-    char operation;
-    uint32_t address;
-    uint32_t cycles = 0;
-    int count = 0;
-    while (traceFile >> operation >> std::hex >> address) {
-        count++;
-        if (!memory->isPageExist(address)) {
-            memory->addPage(address);
+    std::ofstream csvFile("./src/analysis_p2_lower.csv");
+    csvFile << "l2Size,l2Ways,l3Size,l3Ways,blockSize,l2MissRate,l3MissRate,totalCycles,averageCycles" << std::endl;
+    for (const LowerConfig &config : configs) {
+        // like writeResult, with the L1 transfers at the L2 latency
+        uint64_t totalCycles = l1Stats.baseCycles + l1Stats.missCycles * L2_LATENCY + config.l2Stats.missCycles +
+                               config.l3Stats.missCycles;
+        csvFile << config.l2Size << "," << config.l2Ways << "," << config.l3Size << "," << config.l3Ways << ","
+                << config.blockSize << "," << config.l2Stats.missRate() << "," << config.l3Stats.missRate() << ","
+                << totalCycles << "," << (float)totalCycles / traceLength << std::endl;
+    }
+    csvFile.close();
+    if (!reportSliceError) return;
+
+    // simulate every configuration again below a real L1, only from a loaded trace
+    if (streaming) {
+        printf("-e needs the trace loaded, not with -S\n");
+        return;
+    }
+    uint32_t numMismatches = 0;
+    for (const LowerConfig &config : configs) {
+        MemoryManager memory(false);
+        Cache cache1(&memory, L1_LATENCY, 16 * 1024, 64, 1, true, true);
+        Cache cache2(&memory, L2_LATENCY, config.l2Size, config.blockSize, config.l2Ways, true, true);
+        Cache cache3(&memory, L3_LATENCY, config.l3Size, config.blockSize, config.l3Ways, true, true);
+        cache1.set_lower_cache(&cache2);
+        cache2.set_lower_cache(&cache3);
+        setPolicies(&cache1, &cache2, &cache3);
+        uint32_t cycles = 0;
+        uint64_t data = 6;
+        for (size_t i = 0; i < trace.size(); i++) {
+            TraceBuffer::Operation operation = trace.getOperation(i);
+            if (operation == TraceBuffer::OTHER) continue;
+            cache1.access(trace.getAddress(i), trace.getSize(i), operation == TraceBuffer::WRITE, (uint8_t *)&data,
+                          &cycles);
+        }
+        CacheStats diffs[2] = {cache2.stats - config.l2Stats, cache3.stats - config.l3Stats};
+        bool same = true;
+        const uint64_t *fields = (const uint64_t *)diffs;
+        for (size_t f = 0; f < 2 * sizeof(CacheStats) / sizeof(uint64_t); f++) {
+            if (fields[f] != 0) same = false;
         }
-        if (operation == 'r') {
-            uint8_t result = cache->get_byte(address, &cycles);
-            // std::cout << result << std::endl;
-        } else if (operation == 'w') {
-            cache->set_byte(address, 6, &cycles);
+        if (!same) {
+            numMismatches++;
+            printf("L2 %uKB %u-way, L3 %uKB %u-way, %uB blocks: %llu L1 back-invalidations, L2 misses %llu "
+                   "replayed %llu, L2 writebacks %llu replayed %llu, L3 misses %llu replayed %llu\n",
+                   config.l2Size / 1024, config.l2Ways, config.l3Size / 1024, config.l3Ways, config.blockSize,
+                   (unsigned long long)cache1.stats.numBackInvalidate, (unsigned long long)cache2.stats.numMiss(),
+                   (unsigned long long)config.l2Stats.numMiss(), (unsigned long long)cache2.stats.numWriteback,
+                   (unsigned long long)config.l2Stats.numWriteback, (unsigned long long)cache3.stats.numMiss(),
+                   (unsigned long long)config.l3Stats.numMiss());
         }
     }
-    float missRate = (float)cache->numMiss / cache->numAccesses;
-    uint32_t totalCycles = cache->baseCycles + cache->missCycles;
+    printf("Miss stream replay: %u of %u configurations differ\n", numMismatches, (uint32_t)configs.size());
+}
+
+// the statistics of every level, then of the victim cache if there is one
+std::vector<CacheStats> getStats(const Hierarchy &hierarchy) {
+    hierarchy.filter->flush();
+    std::vector<CacheStats> stats;
+    for (Cache *cache : hierarchy.levels) stats.push_back(cache->stats);
+    if (hierarchy.victim != nullptr) stats.push_back(hierarchy.victim->stats);
+    return stats;
+}
+
+std::vector<CacheStats> simulate(Hierarchy (*build)()) {
+    if (streaming) {
+        for (size_t h = 0; h < NUM_STREAMED; h++) {
+            if (streamedBuilds[h] == build) return streamedStats[h];
+        }
+    }
+    if (timeSampling.enabled()) {
+        return simulateTimeSampled(build);
+    }
+    if (numChunks > 1) {
+        std::vector<CacheStats> sliced = simulateSliced(build);
+        if (!reportSliceError) return sliced;
+        Hierarchy serial = build();
+        replay(serial, 0, trace.size());
+        reportError(sliced, getStats(serial), serial.levels.size());
+        deleteHierarchy(serial);
+        return sliced;
+    }
+    Hierarchy hierarchy = build();
+    replay(hierarchy, 0, trace.size());
+    std::vector<CacheStats> stats = getStats(hierarchy);
+    deleteHierarchy(hierarchy);
+    return stats;
+}
+
+// approximate: each chunk starts from a cold hierarchy, replays the warmup
+// window before it without counting, then the chunk itself
+std::vector<CacheStats> simulateSliced(Hierarchy (*build)()) {
+    std::vector<std::vector<CacheStats>> chunkStats(numChunks);
+    parallelFor(numChunks, numChunks, [&](size_t chunk) {
+        size_t begin = trace.size() * chunk / numChunks;
+        size_t end = trace.size() * (chunk + 1) / numChunks;
+        size_t warmupBegin = begin > warmup ? begin - warmup : 0;
+        Hierarchy hierarchy = build();
+        replay(hierarchy, warmupBegin, begin);
+        std::vector<CacheStats> before = getStats(hierarchy);
+        replay(hierarchy, begin, end);
+        std::vector<CacheStats> after = getStats(hierarchy);
+        for (size_t i = 0; i < after.size(); i++) chunkStats[chunk].push_back(after[i] - before[i]);
+        deleteHierarchy(hierarchy);
+    });
+    std::vector<CacheStats> stats = chunkStats[0];
+    for (uint32_t chunk = 1; chunk < numChunks; chunk++) {
+        for (size_t i = 0; i < stats.size(); i++) stats[i] += chunkStats[chunk][i];
+    }
+    return stats;
+}
+
+// the statistics are those of the measured units, the estimates go to sampledMissRate and sampledCpi
+std::vector<CacheStats> simulateTimeSampled(Hierarchy (*build)()) {
+    Hierarchy hierarchy = build();
+    std::vector<CacheStats> total(hierarchy.levels.size() + (hierarchy.victim != nullptr ? 1 : 0));
+    // L1 with the miss cycles of every level, so the sampler sees the cycles of the hierarchy
+    auto combine = [&](const std::vector<CacheStats> &stats) {
+        CacheStats combined = stats[0];
+        for (size_t level = 1; level < hierarchy.levels.size(); level++) combined.missCycles += stats[level].missCycles;
+        return combined;
+    };
+    TimeSampler sampler;
+    // functional warming enters L1 through a filter of its own, always on and without cycles,
+    // the counts it adds to the levels fall outside the units
+    RepeatFilter warming(hierarchy.levels[0], true);
+    for (uint64_t k = 0; k < timeSampling.numSamples(trace.size()); k++) {
+        size_t unitBegin = timeSampling.unitBegin(k);
+        if (timeSampling.functionalWarming) warm(warming, timeSampling.skippedBegin(k), timeSampling.warmupBegin(k));
+        replay(hierarchy, timeSampling.warmupBegin(k), unitBegin);
+        std::vector<CacheStats> before = getStats(hierarchy);
+        sampler.beginUnit(combine(before));
+        replay(hierarchy, unitBegin, unitBegin + timeSampling.unit);
+        std::vector<CacheStats> after = getStats(hierarchy);
+        sampler.endUnit(combine(after), timeSampling.unit);
+        for (size_t i = 0; i < total.size(); i++) total[i] += after[i] - before[i];
+    }
+    sampler.estimate(timeSampling, trace.size(), &sampledMissRate, &sampledCpi);
+    deleteHierarchy(hierarchy);
+    return total;
+}
+
+void reportError(const std::vector<CacheStats> &sliced, const std::vector<CacheStats> &serial, uint32_t numLevels) {
+    printf("---------- time-sliced error, %u chunks, %llu warmup accesses ----------\n", numChunks,
+           (unsigned long long)warmup);
+    uint64_t slicedCycles = sliced[0].baseCycles;
+    uint64_t serialCycles = serial[0].baseCycles;
+    for (uint32_t level = 0; level < numLevels; level++) {
+        slicedCycles += sliced[level].missCycles;
+        serialCycles += serial[level].missCycles;
+        printf("L%u misses: %llu serial: %llu error: %+.3f%%\n", level + 1,
+               (unsigned long long)sliced[level].numMiss(), (unsigned long long)serial[level].numMiss(),
+               serial[level].numMiss() == 0 ? 0.0 :
+               100.0 * ((double)sliced[level].numMiss() - serial[level].numMiss()) / serial[level].numMiss());
+    }
+    printf("Total cycles: %llu serial: %llu error: %+.3f%%\n", (unsigned long long)slicedCycles,
+           (unsigned long long)serialCycles, 100.0 * ((double)slicedCycles - serialCycles) / serialCycles);
+}
+
+// stats holds numLevels levels, then the victim cache if there is one. The
+// cycles are those of L1 plus the miss cycles of every lower level, like Cache::get_total_cycles
+void writeResult(const std::vector<CacheStats> &stats, uint32_t numLevels, std::ofstream &csvFile) {
+    uint64_t count = traceLength;
+    uint64_t totalCycles = stats[0].baseCycles;
+    for (uint32_t level = 0; level < numLevels; level++) totalCycles += stats[level].missCycles;
     float avgCycles = (float )totalCycles / count;
-    csvFile << "single-level cache:" << std::endl;
-    csvFile << "totalCycles: " << totalCycles << "  "
+    if (timeSampling.enabled()) {
+        // estimates, the statistics below are those of the measured units
+        csvFile << "totalCycles: " << (uint64_t)(sampledCpi.value * count + 0.5) << "  "
+            << "average cycles: " << (float)sampledCpi.value << " +- " << (float)sampledCpi.halfWidth << "  "
+            << "L1 miss rate: " << (float)sampledMissRate.value << " +- " << (float)sampledMissRate.halfWidth
+            << std::endl;
+    } else {
+        csvFile << "totalCycles: " << totalCycles << "  "
             << "average cycles: " << avgCycles << std::endl;
+    }
+    if (numLevels == 1) {
+        stats[0].print("single-level");
+        return;
+    }
+    stats[0].print("L1");
+    if (stats.size() > numLevels) {
+        stats[numLevels].print("Victim");
+    }
+    for (uint32_t level = 1; level < numLevels; level++) {
+        char name[16];
+        snprintf(name, sizeof(name), "L%u", level + 1);
+        stats[level].print(name);
+    }
+}
+
+// "-r P" sets every level to P, "-r P1,P2,P3" sets L1, L2 and L3 separately
+bool parsePolicies(const std::string &arg) {
+    std::string names[3];
+    int n = 0;
+    size_t begin = 0;
+    while (n < 3) {
+        size_t end = arg.find(',', begin);
+        names[n++] = arg.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+        if (end == std::string::npos) break;
+        begin = end + 1;
+    }
+    if (n != 1 && n != 3) {
+        return false;
+    }
+    for (int level = 0; level < 3; level++) {
+        if (!ReplacementPolicy::parsePolicy(names[n == 1 ? 0 : level], &policies[level])) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool parseParameters(int argc, char **argv) {
-    traceFilePath = argv[1];
+    for (int i = 1; i < argc; i++) {
+        // a lone "-" is the trace on stdin
+        if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            switch (argv[i][1]) {
+            case 'r':
+                if (i + 1 < argc && parsePolicies(argv[i + 1])) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 't':
+                if (i + 1 < argc) {
+                    eventDumpPath = argv[++i];
+                    break;
+                }
+                return false;
+            case 'p':
+                if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                    numChunks = atoi(argv[++i]);
+                    break;
+                }
+                return false;
+            case 'w':
+                if (i + 1 < argc) {
+                    warmup = strtoull(argv[++i], nullptr, 10);
+                    break;
+                }
+                return false;
+            case 'e':
+                reportSliceError = true;
+                break;
+            case 'f':
+                if (i + 1 < argc && TraceDecoder::parseFormat(argv[i + 1], &traceFormat)) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 'S':
+                streaming = true;
+                break;
+            case 'R':
+                filterRepeats = true;
+                break;
+            case 'L':
+                lowerSweep = true;
+                break;
+            case 'T':
+                if (i + 1 < argc && timeSampling.parse(argv[i + 1])) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 'l':
+                if (i + 1 < argc) {
+                    missStreamPath = argv[++i];
+                    break;
+                }
+                return false;
+            default:
+                return false;
+            }
+        } else if (traceFilePath == nullptr) {
+            traceFilePath = argv[i];
+        } else {
+            return false;
+        }
+    }
     if (traceFilePath == nullptr) {
         return false;
     }
+    // the chunks of -p need the whole trace in memory
+    if (streaming && numChunks > 1) {
+        return false;
+    }
+    if (lowerSweep && numChunks > 1) {
+        return false;
+    }
+    // time sampling replays windows of the loaded trace
+    if (timeSampling.enabled() && (streaming || numChunks > 1 || lowerSweep)) {
+        return false;
+    }
     return true;
 }
+
+void printUsage() {
+    printf("Usage: MulCacheSimulator trace-file [-r policy[,policy,policy]] [-t file] [-p chunks] [-w warmup] [-e] [-S] [-f format] [-R] [-L] [-l file]\n"
+           "       [-T unit,period[,warmup[,warming]]]\n");
+    printf("The trace file can be - for stdin, or a FIFO\n");
+    printf("Parameters: \n\t[-r policy] replacement policy of all levels, or of L1, L2 and L3 separated by commas,\n");
+    printf("\t           accepted policy LRU, PLRU, SRRIP, BRRIP, FIFO, RANDOM\n");
+    printf("\t[-t file] dump the traced cache events to file, needs a build with -DCACHE_TRACE\n");
+    printf("\t[-p chunks] approximate, cut the trace into chunks simulated in parallel from cold caches\n");
+    printf("\t[-w warmup] accesses before each chunk replayed to warm its caches up, at most a chunk,\n");
+    printf("\t           a quarter of a chunk by default\n");
+    printf("\t[-e] with -p, also run the whole trace serially and report the error of the chunks\n");
+    printf("\t[-S] stream the trace through a reader thread once into all the hierarchies instead of loading it,\n");
+    printf("\t           not with -p\n");
+    printf("\t[-f format] format of the trace, auto (detected, the default), text, binary, din, lackey or champsim\n");
+    printf("\t[-R] apply runs of accesses to the same L1 block as bulk hits, faster with the same results\n");
+    printf("\t[-L] simulate L1 once and replay its misses and writebacks into a sweep of L2 and L3\n");
+    printf("\t           configurations, written to ./src/analysis_p2_lower.csv, with -e also check them\n");
+    printf("\t           against the full hierarchy\n");
+    printf("\t[-l file] with -L, also write the L1 miss stream to file as a binary trace\n");
+    printf("\t[-T unit,period[,warmup[,warming]]] time sampling, measure the last unit accesses of every period\n");
+    printf("\t           after simulating the warmup accesses before them (one unit by default), the rest only\n");
+    printf("\t           warms the caches up, or is skipped with warming 0, the CSV has the estimates and their\n");
+    printf("\t           95%% confidence intervals, not with -S or -p\n");
+}
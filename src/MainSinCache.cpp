@@ -1,88 +1,595 @@
 /*
  * Main entrance of the single-level cache simulator.
- * ./SinCacheSimulator path
+ * ./SinCacheSimulator path [-r policy] [-s] [-t file] [-j threads] [-m] [-x] [-c config] [-S] [-f format] [-R] [-k configs] [-T sampling] [-H ratio] [-O]
  */
 
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
 #include <fstream>
+#include <sstream>
+#include <vector>
 #include "Cache.h"
+#include "CacheBatch.h"
 #include "MemoryManager.h"
+#include "NextUseIndex.h"
+#include "Parallel.h"
+#include "PartitionedCache.h"
+#include "RepeatFilter.h"
+#include "Sampling.h"
+#include "StackDistance.h"
+#include "TraceDecoder.h"
+#include "TracePipeline.h"
+#include "TraceReader.h"
+
+// one configuration of the sweep, simulate() fills in its CSV row and statistics
+struct SweepJob
+{
+    uint32_t cacheSize;
+    uint32_t blockSize;
+    uint32_t associativity;
+    bool writeBack;
+    bool writeAllocate;
+    std::string csvRow; // without the OPT column and the line end
+    CacheStats stats;
+    CacheStats optStats; // with -O, the same configuration under Belady's OPT
+    uint32_t setRatio;   // with -H, the set sampling ratio the cache could use
+};
+
+// write-allocate configurations with the same block size and number of sets,
+// simulated together by one stack-distance pass
+struct StackGroup
+{
+    uint32_t blockSize;
+    uint32_t numSets;
+    uint32_t maxWays;
+    std::vector<size_t> jobIds;
+};
 
 bool parseParameters(int argc, char **argv);
-void simulate(uint32_t cacheSize, uint32_t blockSize, uint32_t associativity,
-              bool writeBack, bool writeAllocate, std::ofstream &csvFile);
+void printUsage();
+void addJob(uint32_t cacheSize, uint32_t blockSize, uint32_t associativity, bool writeBack, bool writeAllocate);
+CacheStats simulateCache(const SweepJob &job, const NextUseIndex *nextUse = nullptr);
+bool simulateStreamed(SweepJob &job);
+void simulateBatch(const std::vector<size_t> &jobIds);
+void simulateStackDistance(const StackGroup &group);
+bool simulateOptimal();
+void setResult(SweepJob &job, const CacheStats &stats);
+void setSampledResult(SweepJob &job, const CacheStats &stats, const Estimate &missRate, const Estimate &cpi);
+bool crossCheck();
 
-const char *traceFilePath;
+const char *traceFilePath = nullptr;
+TraceReader::Format traceFormat = TraceReader::AUTO;
+const char *eventDumpPath = nullptr; // binary dump of the traced cache events
+TraceBuffer trace; // loaded once, replayed by every configuration
+TraceSpill spill; // with -O and -S, the streamed trace kept for the passes of OPT
+uint64_t traceLength = 0; // records in the trace, the CPI is per record
+bool streaming = false; // -S, the trace is streamed instead of loaded
+bool filterRepeats = false; // -R, runs of accesses to the same block are applied as bulk hits
+size_t batchSize = CacheBatch::DEFAULT_SIZE; // -k, configurations sharing each pass over the trace
+TimeSampling timeSampling; // -T
+uint32_t setSampleRatio = 1; // -H, 1 of every setSampleRatio sets is simulated
+ReplacementPolicy::Policy policy = ReplacementPolicy::LRU;
+bool printStats = false;
+unsigned numThreads = defaultNumThreads();
+bool singleConfig = false;
+uint32_t config[5] = {0, 0, 0, 1, 1}; // cacheSize, blockSize, associativity, writeBack, writeAllocate of -c
+bool stackDistanceMode = false;
+bool crossCheckMode = false;
+bool optMode = false; // -O, every configuration is also simulated with Belady's OPT
+std::vector<SweepJob> jobs; // in the order of the CSV rows
 
 int main(int argc, char **argv) {
     if (!parseParameters(argc, argv)) {
+        printUsage();
+        return -1;
+    }
+    if (!streaming && !trace.load(traceFilePath, traceFormat)) {
+        printf("Unable to open file %s\n", traceFilePath);
         return -1;
     }
+    traceLength = trace.size();
     std::ofstream csvFile("./src/analysis_p1.csv");
+    bool sampling = timeSampling.enabled() || setSampleRatio > 1;
     csvFile << "cacheSize,blockSize,associativity,writeBack,writeAllocate,"
-             "missRate,totalCycles,CPI" << std::endl;
+             "missRate,totalCycles,CPI" << (sampling ? ",missRateCI,CPICI" : "") << (optMode ? ",optMissRate" : "")
+            << std::endl;
     std::cout << "The tested trace file: " << traceFilePath << std::endl;
-    for (uint32_t cacheSize = 4*1024; cacheSize <= 1024*1024; cacheSize *= 4) {
+    std::cout << "Replacement policy: " << ReplacementPolicy::policyName(policy) << std::endl;
+    if (singleConfig) {
+        addJob(config[0], config[1], config[2], config[3] != 0, config[4] != 0);
+    }
+    for (uint32_t cacheSize = 4*1024; !singleConfig && cacheSize <= 1024*1024; cacheSize *= 4) {
         for (uint32_t blockSize = 32; blockSize <= 256; blockSize *= 2) {
             for (uint32_t associativity = 2; associativity <= 32; associativity *= 2) {
                 uint32_t numSets = cacheSize / blockSize;
                 if (numSets < associativity != 0) continue;
 
-                simulate(cacheSize, blockSize, associativity, false, false, csvFile);
-                simulate(cacheSize, blockSize, associativity, true, false, csvFile);
-                simulate(cacheSize, blockSize, associativity, false, true, csvFile);
-                simulate(cacheSize, blockSize, associativity, true, true, csvFile);
+                addJob(cacheSize, blockSize, associativity, false, false);
+                addJob(cacheSize, blockSize, associativity, true, false);
+                addJob(cacheSize, blockSize, associativity, false, true);
+                addJob(cacheSize, blockSize, associativity, true, true);
+            }
+        }
+    }
+    // addJob(4*1024, 32, 4, false, false);
+    // addJob(4*1024, 32, 4, true, false);
+    // addJob(4*1024, 32, 4, false, true);
+    // addJob(4*1024, 32, 4, true, true);
+
+    if (streaming) {
+        if (optMode && !spill.open()) {
+            printf("Unable to create a temporary file for -O\n");
+            return -1;
+        }
+        if (!simulateStreamed(jobs[0])) {
+            printf("Unable to open file %s\n", traceFilePath);
+            return -1;
+        }
+    } else if (singleConfig && !stackDistanceMode && numThreads > 1 && !sampling) {
+        // a single configuration, the threads split its sets between them
+        SweepJob &job = jobs[0];
+        PartitionedCache cache(numThreads, job.cacheSize, job.blockSize, job.associativity, job.writeBack,
+                               job.writeAllocate, policy, filterRepeats);
+        if (!PartitionedCache::isExact(policy)) {
+            printf("%s shares state across sets, the result differs from a run with -j 1\n",
+                   ReplacementPolicy::policyName(policy).c_str());
+        }
+        setResult(job, cache.run(trace));
+    } else {
+        // in stack-distance mode the write-allocate configurations are grouped by
+        // block size and number of sets, the others are still simulated with Cache
+        std::vector<StackGroup> groups;
+        std::vector<size_t> cacheJobIds;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            const SweepJob &job = jobs[i];
+            if (!stackDistanceMode || !job.writeAllocate) {
+                cacheJobIds.push_back(i);
+                continue;
+            }
+            uint32_t numSets = job.cacheSize / job.blockSize / job.associativity;
+            size_t g = 0;
+            while (g < groups.size() && (groups[g].blockSize != job.blockSize || groups[g].numSets != numSets)) g++;
+            if (g == groups.size()) {
+                StackGroup group;
+                group.blockSize = job.blockSize;
+                group.numSets = numSets;
+                group.maxWays = 0;
+                groups.push_back(group);
+            }
+            if (job.associativity > groups[g].maxWays) groups[g].maxWays = job.associativity;
+            groups[g].jobIds.push_back(i);
+        }
+
+        // the Cache configurations are batched to share their passes over the trace,
+        // but into no fewer batches than threads
+        std::vector<std::vector<size_t>> batches;
+        size_t perBatch = (cacheJobIds.size() + numThreads - 1) / numThreads;
+        if (perBatch > batchSize) perBatch = batchSize;
+        for (size_t i = 0; i < cacheJobIds.size(); i += perBatch) {
+            size_t end = i + perBatch < cacheJobIds.size() ? i + perBatch : cacheJobIds.size();
+            batches.push_back(std::vector<size_t>(cacheJobIds.begin() + i, cacheJobIds.begin() + end));
+        }
+
+        // every configuration has its own memory and cache, only the trace is shared
+        parallelFor(groups.size() + batches.size(), numThreads, [&](size_t i) {
+            if (i < groups.size()) {
+                simulateStackDistance(groups[i]);
+            } else {
+                simulateBatch(batches[i - groups.size()]);
+            }
+        });
+    }
+    if (crossCheckMode && !crossCheck()) {
+        return -1;
+    }
+    if (optMode && !simulateOptimal()) {
+        printf("Unable to write the next-use index of -O to a temporary file\n");
+        return -1;
+    }
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const SweepJob &job = jobs[i];
+        // once for the write policies of a geometry, Cache::setSetSampling keeps at least one sampled set
+        bool sameGeometry = i > 0 && jobs[i - 1].cacheSize == job.cacheSize && jobs[i - 1].blockSize == job.blockSize
+                            && jobs[i - 1].associativity == job.associativity;
+        if (job.setRatio < setSampleRatio && !sameGeometry) {
+            printf("%uKB %uB %u-way has %u sets, sampling 1 of every %u instead of %u\n", job.cacheSize / 1024,
+                   job.blockSize, job.associativity, job.cacheSize / job.blockSize / job.associativity, job.setRatio,
+                   setSampleRatio);
+        }
+        csvFile << job.csvRow;
+        if (optMode) {
+            csvFile << "," << job.optStats.missRate();
+        }
+        csvFile << std::endl;
+        if (printStats) {
+            char name[128];
+            snprintf(name, sizeof(name), "%uKB %uB %u-way %s %s", job.cacheSize / 1024, job.blockSize,
+                     job.associativity, job.writeBack ? "write-back" : "write-through",
+                     job.writeAllocate ? "write-allocate" : "no-write-allocate");
+            job.stats.print(name);
+            if (optMode) {
+                job.optStats.print("OPT");
             }
         }
     }
-    // simulate(4*1024, 32, 4, false, false, csvFile);
-    // simulate(4*1024, 32, 4, true, false, csvFile);
-    // simulate(4*1024, 32, 4, false, true, csvFile);
-    // simulate(4*1024, 32, 4, true, true, csvFile);
     csvFile.close();
+    if (eventDumpPath != nullptr) {
+#ifndef CACHE_TRACE
+        printf("Cache event tracing is not compiled in, build with -DCACHE_TRACE\n");
+#endif
+        if (!CacheTrace::dump(eventDumpPath)) {
+            printf("Unable to write %s\n", eventDumpPath);
+            return -1;
+        }
+    }
     return 0;
 }
 
-void simulate(uint32_t cacheSize, uint32_t blockSize, uint32_t associativity, bool writeBack, bool writeAllocate, std::ofstream &csvFile) {
-    // open the trace file
-    std::ifstream traceFile(traceFilePath);
-    if (!traceFile.is_open()) {
-        printf("Unable to open file %s\n", traceFilePath);
-        exit(-1);
-    }
+void addJob(uint32_t cacheSize, uint32_t blockSize, uint32_t associativity, bool writeBack, bool writeAllocate) {
+    SweepJob job;
+    job.cacheSize = cacheSize;
+    job.blockSize = blockSize;
+    job.associativity = associativity;
+    job.writeBack = writeBack;
+    job.writeAllocate = writeAllocate;
+    job.setRatio = 1;
+    jobs.push_back(job);
+}
 
-    MemoryManager *memory = new MemoryManager();
-    Cache *cache = new Cache(memory, 1, cacheSize, blockSize, associativity, writeBack, writeAllocate);
+// with nextUse, the cache replaces blocks with Belady's OPT instead of the policy of -r
+CacheStats simulateCache(const SweepJob &job, const NextUseIndex *nextUse) {
+    // the trace carries no data values, so only timing is simulated
+    MemoryManager *memory = new MemoryManager(false);
+    Cache *cache = new Cache(memory, 1, job.cacheSize, job.blockSize, job.associativity, job.writeBack, job.writeAllocate);
+    if (nextUse != nullptr) {
+        cache->set_next_use(nextUse);
+    } else {
+        cache->set_replacement_policy(policy);
+    }
+    RepeatFilter filter(cache, filterRepeats);
 
-    char operation;
-    uint32_t address;
     uint32_t cycles = 0;
-    int count = 0;
-    while (traceFile >> operation >> std::hex >> address) {
-        count++;
-        if (!memory->isPageExist(address)) {
-            memory->addPage(address);
+    auto replay = [&](const TraceBuffer &records) {
+        for (size_t i = 0; i < records.size(); i++) {
+            uint32_t address = records.getAddress(i);
+            if (!memory->isPageExist(address)) {
+                memory->addPage(address);
+            }
+            uint64_t data = 6;
+            TraceBuffer::Operation operation = records.getOperation(i);
+            if (operation == TraceBuffer::READ) {
+                filter.access(address, records.getSize(i), false, (uint8_t *)&data, &cycles);
+            } else if (operation == TraceBuffer::WRITE) {
+                filter.access(address, records.getSize(i), true, (uint8_t *)&data, &cycles);
+            }
+        }
+    };
+    if (streaming) {
+        // only OPT replays a streamed trace, from the spill, which simulateOptimal has read back already
+        TraceBuffer chunk;
+        for (uint64_t begin = 0; begin < spill.size(); begin += TraceSpill::CHUNK) {
+            if (!spill.read(begin, TraceSpill::CHUNK, &chunk)) break;
+            replay(chunk);
+        }
+    } else {
+        replay(trace);
+    }
+    filter.flush();
+    CacheStats stats = cache->stats;
+    delete cache;
+    delete memory;
+    return stats;
+}
+
+void simulateBatch(const std::vector<size_t> &jobIds) {
+    CacheBatch batch;
+    batch.setSampling(timeSampling, setSampleRatio);
+    for (size_t jobId : jobIds) {
+        const SweepJob &job = jobs[jobId];
+        batch.add(job.cacheSize, job.blockSize, job.associativity, job.writeBack, job.writeAllocate, policy,
+                  filterRepeats);
+    }
+    batch.run(trace);
+    for (size_t i = 0; i < jobIds.size(); i++) {
+        if (batch.isSampled()) {
+            Estimate missRate;
+            Estimate cpi;
+            batch.getEstimates(i, &missRate, &cpi);
+            setSampledResult(jobs[jobIds[i]], batch.getStats(i), missRate, cpi);
+            jobs[jobIds[i]].setRatio = batch.getSetSamplingRatio(i);
+        } else {
+            setResult(jobs[jobIds[i]], batch.getStats(i));
+        }
+    }
+}
+
+// the trace goes through a reader thread in bounded batches, for traces too
+// long to load, with -j above 1 the threads also split the sets. With -O the
+// reads and writes are spilled for OPT on the way, by a single thread
+bool simulateStreamed(SweepJob &job) {
+    TracePipeline pipeline;
+    if (!pipeline.open(traceFilePath, traceFormat)) {
+        return false;
+    }
+    CacheStats stats;
+    if (numThreads > 1 && !optMode) {
+        PartitionedCache cache(numThreads, job.cacheSize, job.blockSize, job.associativity, job.writeBack,
+                               job.writeAllocate, policy, filterRepeats);
+        stats = cache.run(pipeline);
+    } else {
+        MemoryManager *memory = new MemoryManager(false);
+        Cache *cache = new Cache(memory, 1, job.cacheSize, job.blockSize, job.associativity, job.writeBack,
+                                 job.writeAllocate);
+        cache->set_replacement_policy(policy);
+        RepeatFilter filter(cache, filterRepeats);
+        uint32_t cycles = 0;
+        uint64_t data = 6;
+        size_t count;
+        while (const TraceRecord *records = pipeline.nextBatch(&count)) {
+            for (size_t i = 0; i < count; i++) {
+                if (records[i].operation == TraceBuffer::OTHER) continue;
+                if (optMode) {
+                    spill.append((TraceBuffer::Operation)records[i].operation, records[i].address, records[i].size);
+                }
+                filter.access(records[i].address, records[i].size, records[i].operation == TraceBuffer::WRITE,
+                              (uint8_t *)&data, &cycles);
+            }
+        }
+        filter.flush();
+        stats = cache->stats;
+        delete cache;
+        delete memory;
+    }
+    traceLength = pipeline.getNumRecords();
+    setResult(job, stats);
+    return true;
+}
+
+void simulateStackDistance(const StackGroup &group) {
+    StackDistance stack(group.numSets, group.blockSize, group.maxWays);
+    for (size_t i = 0; i < trace.size(); i++) {
+        TraceBuffer::Operation operation = trace.getOperation(i);
+        if (operation != TraceBuffer::OTHER) {
+            stack.access(trace.getAddress(i), trace.getSize(i), operation == TraceBuffer::WRITE);
+        }
+    }
+    // the latencies of a single-level Cache, 1 cycle to hit and 100 to reach memory
+    for (size_t jobId : group.jobIds) {
+        SweepJob &job = jobs[jobId];
+        setResult(job, stack.getStats(job.associativity, job.writeBack, 1, 100));
+    }
+}
+
+// the OPT statistics of every configuration, the next-use index is built once per
+// block size and shared by its configurations, only one index is kept at a time.
+// False if the index or the spill of a streamed trace can't be written
+bool simulateOptimal() {
+    if (streaming && !spill.flush()) {
+        return false;
+    }
+    std::vector<uint32_t> blockSizes;
+    for (const SweepJob &job : jobs) {
+        bool seen = false;
+        for (uint32_t blockSize : blockSizes) {
+            if (blockSize == job.blockSize) seen = true;
+        }
+        if (!seen) blockSizes.push_back(job.blockSize);
+    }
+    for (uint32_t blockSize : blockSizes) {
+        NextUseIndex nextUse(blockSize);
+        if (!(streaming ? nextUse.build(spill) : nextUse.build(trace))) {
+            return false;
         }
-        if (operation == 'r') {
-            uint8_t result = cache->get_byte(address, &cycles);
-            // std::cout << result << std::endl;
-        } else if (operation == 'w') {
-            cache->set_byte(address, 6, &cycles);
+        std::vector<size_t> jobIds;
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (jobs[i].blockSize == blockSize) jobIds.push_back(i);
         }
+        parallelFor(jobIds.size(), numThreads, [&](size_t i) {
+            SweepJob &job = jobs[jobIds[i]];
+            job.optStats = simulateCache(job, &nextUse);
+        });
     }
-    float missRate = (float) cache->numMiss / cache->numAccesses;
-    uint32_t totalCycles = cache->baseCycles + cache->missCycles;
+    return true;
+}
+
+void setResult(SweepJob &job, const CacheStats &stats) {
+    uint64_t count = traceLength;
+    float missRate = (float) stats.numMiss() / stats.numAccesses();
+    uint64_t totalCycles = stats.baseCycles + stats.missCycles;
     float cpi = (float) totalCycles / count;
-    csvFile << cacheSize << "," << blockSize << "," << associativity << "," << writeBack << ","
-            << writeAllocate << "," << missRate << "," << totalCycles << "," << cpi << std::endl;
+    std::ostringstream csvRow;
+    csvRow << job.cacheSize << "," << job.blockSize << "," << job.associativity << "," << job.writeBack << ","
+           << job.writeAllocate << "," << missRate << "," << totalCycles << "," << cpi;
+    job.csvRow = csvRow.str();
+    job.stats = stats;
+}
+
+// the estimates and their 95% confidence intervals, the statistics are those of the sampled part
+void setSampledResult(SweepJob &job, const CacheStats &stats, const Estimate &missRate, const Estimate &cpi) {
+    uint64_t totalCycles = (uint64_t)(cpi.value * traceLength + 0.5);
+    std::ostringstream csvRow;
+    csvRow << job.cacheSize << "," << job.blockSize << "," << job.associativity << "," << job.writeBack << ","
+           << job.writeAllocate << "," << (float)missRate.value << "," << totalCycles << "," << (float)cpi.value
+           << "," << (float)missRate.halfWidth << "," << (float)cpi.halfWidth;
+    job.csvRow = csvRow.str();
+    job.stats = stats;
+}
+
+// simulate the stack-distance configurations again with Cache and compare every counter
+bool crossCheck() {
+    std::vector<size_t> checkIds;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].writeAllocate) checkIds.push_back(i);
+    }
+    std::vector<CacheStats> expected(checkIds.size());
+    parallelFor(checkIds.size(), numThreads, [&](size_t i) { expected[i] = simulateCache(jobs[checkIds[i]]); });
+    uint32_t numMismatches = 0;
+    for (size_t i = 0; i < checkIds.size(); i++) {
+        const SweepJob &job = jobs[checkIds[i]];
+        CacheStats diff = job.stats - expected[i];
+        const uint64_t *fields = (const uint64_t *)&diff;
+        bool same = true;
+        for (size_t f = 0; f < sizeof(CacheStats) / sizeof(uint64_t); f++) {
+            if (fields[f] != 0) same = false;
+        }
+        if (!same) {
+            numMismatches++;
+            printf("Mismatch %uKB %uB %u-way %s\n", job.cacheSize / 1024, job.blockSize, job.associativity,
+                   job.writeBack ? "write-back" : "write-through");
+            job.stats.print("stack distance");
+            expected[i].print("cache");
+        }
+    }
+    printf("Cross-check: %u of %u configurations differ\n", numMismatches, (uint32_t)checkIds.size());
+    return numMismatches == 0;
+}
+
+// "size,block,ways" or "size,block,ways,writeBack,writeAllocate", sizes in bytes
+bool parseConfig(const char *arg) {
+    int n = sscanf(arg, "%u,%u,%u,%u,%u", &config[0], &config[1], &config[2], &config[3], &config[4]);
+    if (n != 3 && n != 5) {
+        return false;
+    }
+    // the cache needs powers of 2 and at least one set
+    for (int i = 0; i < 3; i++) {
+        if (config[i] == 0 || (config[i] & (config[i] - 1)) != 0) return false;
+    }
+    return config[0] >= config[1] * config[2];
 }
 
 bool parseParameters(int argc, char **argv) {
-    traceFilePath = argv[1];
+    for (int i = 1; i < argc; i++) {
+        // a lone "-" is the trace on stdin
+        if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            switch (argv[i][1]) {
+            case 'r':
+                if (i + 1 < argc && ReplacementPolicy::parsePolicy(argv[i + 1], &policy)) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 's':
+                printStats = true;
+                break;
+            case 'f':
+                if (i + 1 < argc && TraceDecoder::parseFormat(argv[i + 1], &traceFormat)) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 'c':
+                if (i + 1 < argc && parseConfig(argv[i + 1])) {
+                    singleConfig = true;
+                    i++;
+                    break;
+                }
+                return false;
+            case 'S':
+                streaming = true;
+                break;
+            case 'R':
+                filterRepeats = true;
+                break;
+            case 'T':
+                if (i + 1 < argc && timeSampling.parse(argv[i + 1])) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 'H':
+                // Cache::setSetSampling takes a power of 2
+                if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                    setSampleRatio = atoi(argv[++i]);
+                    if ((setSampleRatio & (setSampleRatio - 1)) == 0) break;
+                }
+                return false;
+            case 'k':
+                if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                    batchSize = atoi(argv[++i]);
+                    break;
+                }
+                return false;
+            case 'm':
+                stackDistanceMode = true;
+                break;
+            case 'O':
+                optMode = true;
+                break;
+            case 'x':
+                stackDistanceMode = true;
+                crossCheckMode = true;
+                break;
+            case 'j':
+                if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                    numThreads = atoi(argv[++i]);
+                    break;
+                }
+                return false;
+            case 't':
+                if (i + 1 < argc) {
+                    eventDumpPath = argv[++i];
+                    break;
+                }
+                return false;
+            default:
+                return false;
+            }
+        } else if (traceFilePath == nullptr) {
+            traceFilePath = argv[i];
+        } else {
+            return false;
+        }
+    }
     if (traceFilePath == nullptr) {
         return false;
     }
+    // streaming replays the trace once, for a single configuration
+    if (streaming && (!singleConfig || stackDistanceMode)) {
+        return false;
+    }
+    // sampling goes through CacheBatch, one mode at a time
+    if ((timeSampling.enabled() || setSampleRatio > 1) && (streaming || stackDistanceMode)) {
+        return false;
+    }
+    if (timeSampling.enabled() && setSampleRatio > 1) {
+        return false;
+    }
+    // OPT replays the whole trace against its next-use index, every access is simulated
+    if (optMode && (timeSampling.enabled() || setSampleRatio > 1)) {
+        return false;
+    }
+    // the stack property only holds for LRU
+    if (stackDistanceMode && policy != ReplacementPolicy::LRU) {
+        return false;
+    }
     return true;
 }
+
+void printUsage() {
+    printf("Usage: SinCacheSimulator trace-file [-r policy] [-s] [-t file] [-j threads] [-m] [-x] [-c config] [-S] [-f format] [-R] [-k configs]\n"
+           "       [-T unit,period[,warmup[,warming]]] [-H ratio] [-O]\n");
+    printf("The trace file can be - for stdin, or a FIFO\n");
+    printf("Parameters: \n\t[-r policy] replacement policy, accepted policy LRU, PLRU, SRRIP, BRRIP, FIFO, RANDOM\n");
+    printf("\t[-s] print the statistics of every configuration\n");
+    printf("\t[-t file] dump the traced cache events to file, needs a build with -DCACHE_TRACE\n");
+    printf("\t[-j threads] number of configurations simulated at once, all hardware threads by default\n");
+    printf("\t[-m] simulate the write-allocate LRU configurations with one stack-distance pass per block size and set count\n");
+    printf("\t[-x] like -m, and check the results against the Cache simulation\n");
+    printf("\t[-c size,block,ways[,writeBack,writeAllocate]] simulate only this configuration,\n");
+    printf("\t           the threads of -j then split its sets between them\n");
+    printf("\t[-S] with -c, stream the trace through a reader thread instead of loading it\n");
+    printf("\t[-f format] format of the trace, auto (detected, the default), text, binary, din, lackey or champsim\n");
+    printf("\t[-R] apply runs of accesses to the same block as bulk hits, faster with the same results\n");
+    printf("\t[-k configs] configurations of the sweep replayed together chunk by chunk, so each pass\n");
+    printf("\t           over the trace serves them all, %u by default, 1 replays each on its own\n",
+           (uint32_t)CacheBatch::DEFAULT_SIZE);
+    printf("\t[-T unit,period[,warmup[,warming]]] time sampling, measure the last unit accesses of every period\n");
+    printf("\t           after simulating the warmup accesses before them (one unit by default), the rest only\n");
+    printf("\t           warms the caches up, or is skipped with warming 0\n");
+    printf("\t[-H ratio] set sampling, simulate 1 of every ratio sets (a power of 2)\n");
+    printf("\t           with -T or -H the CSV has the miss rate and CPI estimates and their 95%% confidence intervals\n");
+    printf("\t[-O] also simulate every configuration with Belady's optimal replacement, the CSV gets its miss rate\n");
+    printf("\t           with -S the streamed trace is spilled to $TMPDIR for it, and -j is ignored\n");
+}
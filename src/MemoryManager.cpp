@@ -6,10 +6,15 @@
 #include "Debug.h"
 
 #include <cstdio>
+#include <cstring>
 #include <string>
 
-MemoryManager::MemoryManager() {
+// Shared backing of every page of a timing-only memory, never written
+static uint8_t zeroPage[4096];
+
+MemoryManager::MemoryManager(bool storeData) {
   this->cache = nullptr;
+  this->storeData = storeData;
   for (uint32_t i = 0; i < 1024; ++i) {
     this->memory[i] = nullptr;
   }
@@ -19,7 +24,7 @@ MemoryManager::~MemoryManager() {
   for (uint32_t i = 0; i < 1024; ++i) {
     if (this->memory[i] != nullptr) {
       for (uint32_t j = 0; j < 1024; ++j) {
-        if (this->memory[i][j] != nullptr) {
+        if (this->memory[i][j] != nullptr && this->memory[i][j] != zeroPage) {
           delete[] this->memory[i][j];
           this->memory[i][j] = nullptr;
         }
@@ -38,6 +43,10 @@ bool MemoryManager::addPage(uint32_t addr) {
     memset(this->memory[i], 0, sizeof(uint8_t *) * 1024);
   }
   if (this->memory[i][j] == nullptr) {
+    if (!this->storeData) {
+      this->memory[i][j] = zeroPage;
+      return true;
+    }
     this->memory[i][j] = new uint8_t[4096];
     memset(this->memory[i][j], 0, 4096);
   } else {
@@ -74,11 +83,7 @@ bool MemoryManager::setByte(uint32_t addr, uint8_t val, uint32_t *cycles) {
   }
   if (cycles != nullptr && this->cache == nullptr)
     *cycles = 100;
-  uint32_t i = this->getFirstEntryId(addr);
-  uint32_t j = this->getSecondEntryId(addr);
-  uint32_t k = this->getPageOffset(addr);
-  this->memory[i][j][k] = val;
-  return true;
+  return this->setByteNoCache(addr, val);
 }
 
 bool MemoryManager::setByteNoCache(uint32_t addr, uint8_t val) {
@@ -86,6 +91,9 @@ bool MemoryManager::setByteNoCache(uint32_t addr, uint8_t val) {
     dbgprintf("Byte write to invalid addr 0x%x!\n", addr);
     return false;
   }
+  if (!this->storeData) {
+    return true;
+  }
 
   uint32_t i = this->getFirstEntryId(addr);
   uint32_t j = this->getSecondEntryId(addr);
@@ -121,69 +129,131 @@ uint8_t MemoryManager::getByteNoCache(uint32_t addr) {
   return this->memory[i][j][k];
 }
 
-bool MemoryManager::setShort(uint32_t addr, uint16_t val, uint32_t *cycles) {
-  if (!this->isAddrExist(addr)) {
-    dbgprintf("Short write to invalid addr 0x%x!\n", addr);
-    return false;
+bool MemoryManager::setBytesNoCache(uint32_t addr, const uint8_t *buf,
+                                    uint32_t len) {
+  if (!this->storeData) {
+    return this->isAddrExist(addr);
+  }
+  while (len > 0) {
+    if (!this->isAddrExist(addr)) {
+      dbgprintf("Block write to invalid addr 0x%x!\n", addr);
+      return false;
+    }
+    uint32_t k = this->getPageOffset(addr);
+    uint32_t n = 4096 - k < len ? 4096 - k : len;
+    memcpy(&this->memory[this->getFirstEntryId(addr)]
+                        [this->getSecondEntryId(addr)][k],
+           buf, n);
+    addr += n;
+    buf += n;
+    len -= n;
   }
-  this->setByte(addr, val & 0xFF, cycles);
-  this->setByte(addr + 1, (val >> 8) & 0xFF);
   return true;
 }
 
+bool MemoryManager::getBytesNoCache(uint32_t addr, uint8_t *buf, uint32_t len) {
+  while (len > 0) {
+    if (!this->isAddrExist(addr)) {
+      dbgprintf("Block read to invalid addr 0x%x!\n", addr);
+      return false;
+    }
+    uint32_t k = this->getPageOffset(addr);
+    uint32_t n = 4096 - k < len ? 4096 - k : len;
+    memcpy(buf,
+           &this->memory[this->getFirstEntryId(addr)]
+                        [this->getSecondEntryId(addr)][k],
+           n);
+    addr += n;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+// Multi-byte accesses go to the cache as one access (split only at block
+// boundaries) instead of one access per byte
+bool MemoryManager::setBytes(uint32_t addr, const uint8_t *buf, uint32_t len,
+                             uint32_t *cycles) {
+  if (!this->isAddrExist(addr) || !this->isAddrExist(addr + len - 1)) {
+    dbgprintf("Write to invalid addr 0x%x!\n", addr);
+    return false;
+  }
+  if (this->cache != nullptr) {
+    this->cache->access(addr, len, true, (uint8_t *)buf, cycles);
+    return true;
+  }
+  if (cycles != nullptr)
+    *cycles = 100;
+  return this->setBytesNoCache(addr, buf, len);
+}
+
+bool MemoryManager::getBytes(uint32_t addr, uint8_t *buf, uint32_t len,
+                             uint32_t *cycles) {
+  if (!this->isAddrExist(addr) || !this->isAddrExist(addr + len - 1)) {
+    dbgprintf("Read to invalid addr 0x%x!\n", addr);
+    memset(buf, 0, len);
+    return false;
+  }
+  if (this->cache != nullptr) {
+    if (!this->storeData) {
+      memset(buf, 0, len);
+    }
+    this->cache->access(addr, len, false, buf, cycles);
+    return true;
+  }
+  if (cycles != nullptr)
+    *cycles = 100;
+  return this->getBytesNoCache(addr, buf, len);
+}
+
+bool MemoryManager::setShort(uint32_t addr, uint16_t val, uint32_t *cycles) {
+  uint8_t buf[2];
+  for (uint32_t i = 0; i < 2; ++i) {
+    buf[i] = (val >> (8 * i)) & 0xFF;
+  }
+  return this->setBytes(addr, buf, 2, cycles);
+}
+
 uint16_t MemoryManager::getShort(uint32_t addr, uint32_t *cycles) {
-  uint32_t b1 = this->getByte(addr, cycles);
-  uint32_t b2 = this->getByte(addr + 1);
-  return b1 + (b2 << 8);
+  uint8_t buf[2];
+  this->getBytes(addr, buf, 2, cycles);
+  return buf[0] + (buf[1] << 8);
 }
 
 bool MemoryManager::setInt(uint32_t addr, uint32_t val, uint32_t *cycles) {
-  if (!this->isAddrExist(addr)) {
-    dbgprintf("Int write to invalid addr 0x%x!\n", addr);
-    return false;
+  uint8_t buf[4];
+  for (uint32_t i = 0; i < 4; ++i) {
+    buf[i] = (val >> (8 * i)) & 0xFF;
   }
-  this->setByte(addr, val & 0xFF, cycles);
-  this->setByte(addr + 1, (val >> 8) & 0xFF);
-  this->setByte(addr + 2, (val >> 16) & 0xFF);
-  this->setByte(addr + 3, (val >> 24) & 0xFF);
-  return true;
+  return this->setBytes(addr, buf, 4, cycles);
 }
 
 uint32_t MemoryManager::getInt(uint32_t addr, uint32_t *cycles) {
-  uint32_t b1 = this->getByte(addr, cycles);
-  uint32_t b2 = this->getByte(addr + 1);
-  uint32_t b3 = this->getByte(addr + 2);
-  uint32_t b4 = this->getByte(addr + 3);
-  return b1 + (b2 << 8) + (b3 << 16) + (b4 << 24);
+  uint8_t buf[4];
+  this->getBytes(addr, buf, 4, cycles);
+  uint32_t val = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    val |= (uint32_t)buf[i] << (8 * i);
+  }
+  return val;
 }
 
 bool MemoryManager::setLong(uint32_t addr, uint64_t val, uint32_t *cycles) {
-  if (!this->isAddrExist(addr)) {
-    dbgprintf("Long write to invalid addr 0x%x!\n", addr);
-    return false;
+  uint8_t buf[8];
+  for (uint32_t i = 0; i < 8; ++i) {
+    buf[i] = (val >> (8 * i)) & 0xFF;
   }
-  this->setByte(addr, val & 0xFF, cycles);
-  this->setByte(addr + 1, (val >> 8) & 0xFF);
-  this->setByte(addr + 2, (val >> 16) & 0xFF);
-  this->setByte(addr + 3, (val >> 24) & 0xFF);
-  this->setByte(addr + 4, (val >> 32) & 0xFF);
-  this->setByte(addr + 5, (val >> 40) & 0xFF);
-  this->setByte(addr + 6, (val >> 48) & 0xFF);
-  this->setByte(addr + 7, (val >> 56) & 0xFF);
-  return true;
+  return this->setBytes(addr, buf, 8, cycles);
 }
 
 uint64_t MemoryManager::getLong(uint32_t addr, uint32_t *cycles) {
-  uint64_t b1 = this->getByte(addr, cycles);
-  uint64_t b2 = this->getByte(addr + 1);
-  uint64_t b3 = this->getByte(addr + 2);
-  uint64_t b4 = this->getByte(addr + 3);
-  uint64_t b5 = this->getByte(addr + 4);
-  uint64_t b6 = this->getByte(addr + 5);
-  uint64_t b7 = this->getByte(addr + 6);
-  uint64_t b8 = this->getByte(addr + 7);
-  return b1 + (b2 << 8) + (b3 << 16) + (b4 << 24) + (b5 << 32) + (b6 << 40) +
-         (b7 << 48) + (b8 << 56);
+  uint8_t buf[8];
+  this->getBytes(addr, buf, 8, cycles);
+  uint64_t val = 0;
+  for (uint32_t i = 0; i < 8; ++i) {
+    val |= (uint64_t)buf[i] << (8 * i);
+  }
+  return val;
 }
 
 void MemoryManager::printInfo() {
@@ -205,7 +275,12 @@ void MemoryManager::printInfo() {
 
 void MemoryManager::printStatistics() {
   printf("---------- CACHE STATISTICS ----------\n");
-  // this->cache->printStatistics();
+  char name[16];
+  int level = 1;
+  for (Cache *current = this->cache; current != nullptr; current = current->lowerCache) {
+    snprintf(name, sizeof(name), "L%d", level++);
+    current->printStatistics(name);
+  }
 }
 
 std::string MemoryManager::dumpMemory() {
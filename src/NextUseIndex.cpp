@@ -0,0 +1,292 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#include "NextUseIndex.h"
+
+const uint64_t NextUseIndex::NEVER;
+const size_t NextUseIndex::WINDOW_SIZE;
+const size_t TraceSpill::CHUNK;
+
+NextUseIndex::NextUseIndex(uint32_t blockSize) {
+    this->offsetBits = 0;
+    while ((1u << this->offsetBits) < blockSize) this->offsetBits++;
+    this->fd = -1;
+    this->numAccesses = 0;
+    this->position = 0;
+    this->fill = 0;
+    this->failed = false;
+}
+
+NextUseIndex::~NextUseIndex() {
+    if (this->fd >= 0) {
+        close(this->fd);
+    }
+}
+
+bool NextUseIndex::build(const TraceBuffer &trace) {
+    if (!this->start(this->countAccesses(trace))) {
+        return false;
+    }
+    this->addBackward(trace);
+    return this->finish();
+}
+
+bool NextUseIndex::build(const TraceSpill &spill) {
+    TraceBuffer chunk;
+    uint64_t numAccesses = 0;
+    for (uint64_t begin = 0; begin < spill.size(); begin += TraceSpill::CHUNK) {
+        if (!spill.read(begin, TraceSpill::CHUNK, &chunk)) {
+            return false;
+        }
+        numAccesses += this->countAccesses(chunk);
+    }
+    if (!this->start(numAccesses)) {
+        return false;
+    }
+    // the last chunk is the partial one
+    uint64_t begin = spill.size() / TraceSpill::CHUNK * TraceSpill::CHUNK;
+    for (;; begin -= TraceSpill::CHUNK) {
+        if (!spill.read(begin, TraceSpill::CHUNK, &chunk)) {
+            return false;
+        }
+        this->addBackward(chunk);
+        if (begin == 0) break;
+    }
+    return this->finish();
+}
+
+uint64_t NextUseIndex::countAccesses(const TraceBuffer &records) const {
+    uint32_t blockSize = 1u << this->offsetBits;
+    uint64_t count = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records.getOperation(i) == TraceBuffer::OTHER) continue;
+        uint32_t offset = records.getAddress(i) & (blockSize - 1);
+        count += (offset + records.getSize(i) + blockSize - 1) >> this->offsetBits;
+    }
+    return count;
+}
+
+bool NextUseIndex::start(uint64_t numAccesses) {
+    if (this->fd >= 0) {
+        close(this->fd);
+    }
+    this->fd = TraceSpill::createTemporary();
+    this->numAccesses = numAccesses;
+    this->position = numAccesses;
+    this->window.resize(WINDOW_SIZE);
+    this->fill = WINDOW_SIZE;
+    this->failed = false;
+    // sized up front so the readers can map the windows
+    return this->fd >= 0 && ftruncate(this->fd, (off_t)(numAccesses * sizeof(uint64_t))) == 0;
+}
+
+void NextUseIndex::addBackward(const TraceBuffer &records) {
+    uint32_t blockSize = 1u << this->offsetBits;
+    for (size_t i = records.size(); i-- > 0;) {
+        if (records.getOperation(i) == TraceBuffer::OTHER) continue;
+        // split like Cache::access, at most 8 blocks as the size is at most 8 bytes
+        uint32_t addr = records.getAddress(i);
+        uint32_t size = records.getSize(i);
+        uint32_t blocks[8];
+        uint32_t numBlocks = 0;
+        while (size > 0) {
+            uint32_t len = blockSize - (addr & (blockSize - 1));
+            if (len > size) len = size;
+            blocks[numBlocks++] = addr >> this->offsetBits;
+            addr += len;
+            size -= len;
+        }
+        while (numBlocks > 0) {
+            this->add(blocks[--numBlocks]);
+        }
+    }
+}
+
+inline void NextUseIndex::add(uint32_t block) {
+    this->position--;
+    uint64_t nextUse = NEVER;
+    auto next = this->nextUses.insert(std::make_pair(block, this->position));
+    if (!next.second) {
+        nextUse = next.first->second;
+        next.first->second = this->position;
+    }
+    this->window[--this->fill] = nextUse;
+    if (this->fill == 0) {
+        this->writeWindow();
+    }
+}
+
+// the filled part of the window holds the entries from position on
+void NextUseIndex::writeWindow() {
+    const char *p = (const char *)(this->window.data() + this->fill);
+    size_t length = (WINDOW_SIZE - this->fill) * sizeof(uint64_t);
+    uint64_t offset = this->position * sizeof(uint64_t);
+    while (length > 0 && !this->failed) {
+        ssize_t n = pwrite(this->fd, p, length, offset);
+        if (n <= 0) {
+            this->failed = true;
+            break;
+        }
+        p += n;
+        length -= n;
+        offset += n;
+    }
+    this->fill = WINDOW_SIZE;
+}
+
+bool NextUseIndex::finish() {
+    this->writeWindow();
+    std::unordered_map<uint32_t, uint64_t>().swap(this->nextUses);
+    std::vector<uint64_t>().swap(this->window);
+    return !this->failed && this->position == 0;
+}
+
+TraceSpill::TraceSpill() {
+    this->fd = -1;
+    this->numRecords = 0;
+    this->failed = false;
+}
+
+TraceSpill::~TraceSpill() {
+    if (this->fd >= 0) {
+        ::close(this->fd);
+    }
+}
+
+int TraceSpill::createTemporary() {
+    const char *dir = getenv("TMPDIR");
+    std::string path = std::string(dir != nullptr && dir[0] != '\0' ? dir : "/tmp") + "/cachesim.XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    int fd = mkstemp(name.data());
+    if (fd >= 0) {
+        // the file goes away with the descriptor
+        unlink(name.data());
+    }
+    return fd;
+}
+
+bool TraceSpill::open() {
+    if (this->fd >= 0) {
+        ::close(this->fd);
+    }
+    this->fd = createTemporary();
+    this->numRecords = 0;
+    this->buffer.clear();
+    this->failed = false;
+    return this->fd >= 0;
+}
+
+void TraceSpill::append(TraceBuffer::Operation operation, uint32_t address, uint32_t size) {
+    uint64_t sizeBits = size >= 8 ? 3 : size >= 4 ? 2 : size >= 2 ? 1 : 0;
+    this->buffer.push_back(address | (uint64_t)(operation | sizeBits << 2) << 32);
+    this->numRecords++;
+    if (this->buffer.size() == CHUNK) {
+        this->flush();
+    }
+}
+
+bool TraceSpill::flush() {
+    const char *p = (const char *)this->buffer.data();
+    size_t length = this->buffer.size() * sizeof(uint64_t);
+    uint64_t offset = (this->numRecords - this->buffer.size()) * sizeof(uint64_t);
+    while (length > 0 && !this->failed) {
+        ssize_t n = pwrite(this->fd, p, length, offset);
+        if (n <= 0) {
+            this->failed = true;
+            break;
+        }
+        p += n;
+        length -= n;
+        offset += n;
+    }
+    this->buffer.clear();
+    return !this->failed;
+}
+
+bool TraceSpill::read(uint64_t begin, size_t count, TraceBuffer *chunk) const {
+    chunk->clear();
+    if (begin >= this->numRecords) {
+        return true;
+    }
+    if (count > this->numRecords - begin) count = this->numRecords - begin;
+    std::vector<uint64_t> records(count);
+    size_t length = count * sizeof(uint64_t);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pread(this->fd, (char *)records.data() + done, length - done, begin * sizeof(uint64_t) + done);
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    for (uint64_t record : records) {
+        uint32_t kind = (uint32_t)(record >> 32);
+        chunk->append((TraceBuffer::Operation)(kind & 3), (uint32_t)record, 1u << (kind >> 2));
+    }
+    return true;
+}
+
+NextUseReader::NextUseReader(const NextUseIndex *index) {
+    this->index = index;
+    this->windowBegin = 0;
+    this->window = nullptr;
+    this->windowLength = 0;
+    this->cur = nullptr;
+    this->end = nullptr;
+}
+
+NextUseReader::~NextUseReader() {
+    this->unmapWindow();
+}
+
+bool NextUseReader::mapWindow() {
+    uint64_t begin = this->windowBegin + this->windowLength;
+    this->unmapWindow();
+    uint64_t remaining = this->index->size() - begin;
+    size_t length = remaining < NextUseIndex::WINDOW_SIZE ? (size_t)remaining : NextUseIndex::WINDOW_SIZE;
+    if (length == 0) {
+        return false;
+    }
+    // the windows start at multiples of WINDOW_SIZE entries, so their offsets are page aligned
+#if defined(__linux__)
+    void *p = mmap(nullptr, length * sizeof(uint64_t), PROT_READ, MAP_PRIVATE, this->index->fd,
+                   (off_t)(begin * sizeof(uint64_t)));
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    madvise(p, length * sizeof(uint64_t), MADV_SEQUENTIAL);
+    this->window = (const uint64_t *)p;
+#else
+    this->buffer.resize(length);
+    size_t done = 0;
+    while (done < length * sizeof(uint64_t)) {
+        ssize_t n = pread(this->index->fd, (char *)this->buffer.data() + done, length * sizeof(uint64_t) - done,
+                          begin * sizeof(uint64_t) + done);
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    this->window = this->buffer.data();
+#endif
+    this->windowBegin = begin;
+    this->windowLength = length;
+    this->cur = this->window;
+    this->end = this->window + length;
+    return true;
+}
+
+void NextUseReader::unmapWindow() {
+#if defined(__linux__)
+    if (this->window != nullptr) {
+        munmap((void *)this->window, this->windowLength * sizeof(uint64_t));
+    }
+#endif
+    this->window = nullptr;
+    this->cur = nullptr;
+    this->end = nullptr;
+}
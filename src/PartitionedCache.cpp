@@ -0,0 +1,109 @@
+#include "PartitionedCache.h"
+#include "RepeatFilter.h"
+
+PartitionedCache::PartitionedCache(uint32_t numWorkers, uint32_t cacheSize, uint32_t blockSize, uint32_t associativity,
+                                   bool writeBack, bool writeAllocate, ReplacementPolicy::Policy policy,
+                                   bool filterRepeats) {
+    uint32_t numSets = cacheSize / blockSize / associativity;
+    this->workerBits = 0;
+    while ((2u << this->workerBits) <= numWorkers && (2u << this->workerBits) <= numSets) this->workerBits++;
+    this->numWorkers = 1u << this->workerBits;
+    this->blockSize = blockSize;
+    this->filterRepeats = filterRepeats;
+    this->offsetBits = 0;
+    while ((1u << this->offsetBits) < blockSize) this->offsetBits++;
+    this->indexBits = 0;
+    while ((1u << this->indexBits) < numSets) this->indexBits++;
+    // the trace carries no data values, so only timing is simulated
+    for (uint32_t w = 0; w < this->numWorkers; w++) {
+        MemoryManager *memory = new MemoryManager(false);
+        Cache *cache = new Cache(memory, 1, cacheSize / this->numWorkers, blockSize, associativity, writeBack,
+                                 writeAllocate);
+        cache->set_replacement_policy(policy);
+        this->memories.push_back(memory);
+        this->caches.push_back(cache);
+    }
+}
+
+PartitionedCache::~PartitionedCache() {
+    for (Cache *cache : this->caches) delete cache;
+    for (MemoryManager *memory : this->memories) delete memory;
+}
+
+bool PartitionedCache::isExact(ReplacementPolicy::Policy policy) {
+    return policy != ReplacementPolicy::BRRIP && policy != ReplacementPolicy::RANDOM;
+}
+
+CacheStats PartitionedCache::run(const TraceBuffer &trace) {
+    this->startWorkers();
+    for (size_t i = 0; i < trace.size(); i++) {
+        TraceBuffer::Operation operation = trace.getOperation(i);
+        if (operation == TraceBuffer::OTHER) continue;
+        this->dispatch(trace.getAddress(i), trace.getSize(i), operation == TraceBuffer::WRITE);
+    }
+    return this->finish();
+}
+
+CacheStats PartitionedCache::run(TracePipeline &pipeline) {
+    this->startWorkers();
+    size_t count;
+    while (const TraceRecord *records = pipeline.nextBatch(&count)) {
+        for (size_t i = 0; i < count; i++) {
+            if (records[i].operation == TraceBuffer::OTHER) continue;
+            this->dispatch(records[i].address, records[i].size, records[i].operation == TraceBuffer::WRITE);
+        }
+    }
+    return this->finish();
+}
+
+void PartitionedCache::startWorkers() {
+    const size_t QUEUE_SIZE = 1 << 14;
+    for (uint32_t w = 0; w < this->numWorkers; w++) {
+        SpscQueue<Access> *queue = new SpscQueue<Access>(QUEUE_SIZE);
+        this->queues.push_back(queue);
+        Cache *cache = this->caches[w];
+        bool filterRepeats = this->filterRepeats;
+        this->workers.emplace_back([cache, queue, filterRepeats]() {
+            RepeatFilter filter(cache, filterRepeats);
+            uint32_t cycles = 0;
+            uint64_t data = 6;
+            Access access;
+            while (queue->pop(&access)) {
+                filter.access(access.addr, access.size, access.isWrite, (uint8_t *)&data, &cycles);
+            }
+            filter.flush();
+        });
+    }
+}
+
+// split the access into blocks, a block goes to the worker owning its set
+void PartitionedCache::dispatch(uint32_t addr, uint32_t size, bool isWrite) {
+    uint32_t workerMask = this->numWorkers - 1;
+    uint32_t tagShift = this->offsetBits + this->indexBits;
+    while (size > 0) {
+        uint32_t offset = addr & (this->blockSize - 1);
+        uint32_t len = this->blockSize - offset;
+        if (len > size) len = size;
+        uint32_t index = (addr >> this->offsetBits) & ((1u << this->indexBits) - 1);
+        uint32_t tag = tagShift < 32 ? addr >> tagShift : 0;
+        Access access;
+        access.addr = (tag << (tagShift - this->workerBits)) | ((index >> this->workerBits) << this->offsetBits) | offset;
+        access.size = (uint16_t)len;
+        access.isWrite = isWrite;
+        this->queues[index & workerMask]->push(access);
+        addr += len;
+        size -= len;
+    }
+}
+
+CacheStats PartitionedCache::finish() {
+    for (SpscQueue<Access> *queue : this->queues) queue->close();
+    for (std::thread &worker : this->workers) worker.join();
+    for (SpscQueue<Access> *queue : this->queues) delete queue;
+    this->queues.clear();
+    this->workers.clear();
+
+    CacheStats stats;
+    for (Cache *cache : this->caches) stats += cache->stats;
+    return stats;
+}
@@ -0,0 +1,229 @@
+#include "ReplacementPolicy.h"
+#include "NextUseIndex.h"
+
+ReplacementPolicy *ReplacementPolicy::create(Policy policy, uint32_t numSets, uint32_t associativity, uint32_t seed) {
+    switch (policy) {
+    case PLRU:
+        return new PLRUPolicy(numSets, associativity);
+    case SRRIP:
+        return new RRIPPolicy(numSets, associativity, false);
+    case BRRIP:
+        return new RRIPPolicy(numSets, associativity, true);
+    case FIFO:
+        return new LRUPolicy(numSets, associativity, false);
+    case RANDOM:
+        return new RandomPolicy(associativity, seed);
+    case LRU:
+    default:
+        return new LRUPolicy(numSets, associativity, true);
+    }
+}
+
+bool ReplacementPolicy::parsePolicy(const std::string &name, Policy *policy) {
+    const Policy all[] = {LRU, PLRU, SRRIP, BRRIP, FIFO, RANDOM};
+    for (Policy p : all) {
+        if (name == policyName(p)) {
+            *policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string ReplacementPolicy::policyName(Policy policy) {
+    switch (policy) {
+    case LRU: return "LRU";
+    case PLRU: return "PLRU";
+    case SRRIP: return "SRRIP";
+    case BRRIP: return "BRRIP";
+    case FIFO: return "FIFO";
+    case RANDOM: return "RANDOM";
+    case OPT: return "OPT";
+    }
+    return "error";
+}
+
+LRUPolicy::LRUPolicy(uint32_t numSets, uint32_t associativity, bool moveOnHit) {
+    this->associativity = associativity;
+    this->moveOnHit = moveOnHit;
+    this->prev.resize((size_t)numSets * associativity);
+    this->next.resize((size_t)numSets * associativity);
+    this->head.resize(numSets);
+    this->tail.resize(numSets);
+    // initial order: way 0 is the most recently used
+    for (uint32_t set = 0; set < numSets; set++) {
+        uint32_t start = set * associativity;
+        for (uint32_t way = 0; way < associativity; way++) {
+            this->prev[start + way] = way - 1;
+            this->next[start + way] = way + 1;
+        }
+        this->head[set] = 0;
+        this->tail[set] = associativity - 1;
+    }
+}
+
+void LRUPolicy::moveToFront(uint32_t set, uint32_t way) {
+    if (this->head[set] == way) return;
+    uint32_t start = set * this->associativity;
+    uint32_t p = this->prev[start + way];
+    uint32_t n = this->next[start + way];
+    // unlink, way is not the head so p is a valid way
+    this->next[start + p] = n;
+    if (this->tail[set] == way) {
+        this->tail[set] = p;
+    } else {
+        this->prev[start + n] = p;
+    }
+    // link in front of the old head
+    this->prev[start + this->head[set]] = way;
+    this->next[start + way] = this->head[set];
+    this->head[set] = way;
+}
+
+void LRUPolicy::touch(uint32_t set, uint32_t way) {
+    if (this->moveOnHit) this->moveToFront(set, way);
+}
+
+void LRUPolicy::insert(uint32_t set, uint32_t way) {
+    this->moveToFront(set, way);
+}
+
+uint32_t LRUPolicy::getVictim(uint32_t set) {
+    return this->tail[set];
+}
+
+ReplacementPolicy::Policy LRUPolicy::getPolicy() {
+    return this->moveOnHit ? LRU : FIFO;
+}
+
+PLRUPolicy::PLRUPolicy(uint32_t numSets, uint32_t associativity) {
+    this->associativity = associativity;
+    this->bits.assign((size_t)numSets * associativity, 0);
+}
+
+void PLRUPolicy::touch(uint32_t set, uint32_t way) {
+    uint8_t *tree = &this->bits[(size_t)set * this->associativity];
+    // walk from the leaf to the root, pointing every node away from this way
+    for (uint32_t node = way + this->associativity; node > 1; node >>= 1) {
+        tree[node >> 1] = (node & 1) ^ 1;
+    }
+}
+
+void PLRUPolicy::insert(uint32_t set, uint32_t way) {
+    this->touch(set, way);
+}
+
+uint32_t PLRUPolicy::getVictim(uint32_t set) {
+    const uint8_t *tree = &this->bits[(size_t)set * this->associativity];
+    uint32_t node = 1;
+    while (node < this->associativity) {
+        node = 2 * node + tree[node];
+    }
+    return node - this->associativity;
+}
+
+ReplacementPolicy::Policy PLRUPolicy::getPolicy() {
+    return PLRU;
+}
+
+const uint8_t RRIPPolicy::MAX_RRPV;
+const uint32_t RRIPPolicy::BIMODAL_PERIOD;
+
+RRIPPolicy::RRIPPolicy(uint32_t numSets, uint32_t associativity, bool bimodal) {
+    this->associativity = associativity;
+    this->bimodal = bimodal;
+    this->numInserts = 0;
+    this->rrpv.assign((size_t)numSets * associativity, MAX_RRPV);
+}
+
+void RRIPPolicy::touch(uint32_t set, uint32_t way) {
+    this->rrpv[(size_t)set * this->associativity + way] = 0;
+}
+
+void RRIPPolicy::insert(uint32_t set, uint32_t way) {
+    uint8_t value = MAX_RRPV - 1;
+    if (this->bimodal && (this->numInserts++ % BIMODAL_PERIOD) != 0) {
+        value = MAX_RRPV;
+    }
+    this->rrpv[(size_t)set * this->associativity + way] = value;
+}
+
+uint32_t RRIPPolicy::getVictim(uint32_t set) {
+    uint8_t *values = &this->rrpv[(size_t)set * this->associativity];
+    // age the whole set at once by the distance of its oldest way from MAX_RRPV
+    uint8_t oldest = 0;
+    for (uint32_t way = 0; way < this->associativity; way++) {
+        if (values[way] > oldest) oldest = values[way];
+    }
+    if (oldest < MAX_RRPV) {
+        uint8_t delta = MAX_RRPV - oldest;
+        for (uint32_t way = 0; way < this->associativity; way++) {
+            values[way] += delta;
+        }
+    }
+    for (uint32_t way = 0; way < this->associativity; way++) {
+        if (values[way] == MAX_RRPV) return way;
+    }
+    return 0;
+}
+
+ReplacementPolicy::Policy RRIPPolicy::getPolicy() {
+    return this->bimodal ? BRRIP : SRRIP;
+}
+
+RandomPolicy::RandomPolicy(uint32_t associativity, uint32_t seed) {
+    this->associativity = associativity;
+    this->state = seed != 0 ? seed : 1;
+}
+
+void RandomPolicy::touch(uint32_t /*set*/, uint32_t /*way*/) {}
+
+void RandomPolicy::insert(uint32_t /*set*/, uint32_t /*way*/) {}
+
+uint32_t RandomPolicy::getVictim(uint32_t /*set*/) {
+    this->state ^= this->state << 13;
+    this->state ^= this->state >> 17;
+    this->state ^= this->state << 5;
+    return this->state % this->associativity;
+}
+
+ReplacementPolicy::Policy RandomPolicy::getPolicy() {
+    return RANDOM;
+}
+
+OPTPolicy::OPTPolicy(uint32_t numSets, uint32_t associativity, const NextUseIndex *index) {
+    this->associativity = associativity;
+    this->reader = new NextUseReader(index);
+    this->current = NextUseIndex::NEVER;
+    this->nextUses.assign((size_t)numSets * associativity, NextUseIndex::NEVER);
+}
+
+OPTPolicy::~OPTPolicy() {
+    delete this->reader;
+}
+
+// accesses past the end of the index are treated as the last use of their block
+void OPTPolicy::advance() {
+    this->current = this->reader->next();
+}
+
+void OPTPolicy::touch(uint32_t set, uint32_t way) {
+    this->nextUses[set * this->associativity + way] = this->current;
+}
+
+void OPTPolicy::insert(uint32_t set, uint32_t way) {
+    this->nextUses[set * this->associativity + way] = this->current;
+}
+
+uint32_t OPTPolicy::getVictim(uint32_t set) {
+    const uint64_t *values = &this->nextUses[set * this->associativity];
+    uint32_t victim = 0;
+    for (uint32_t way = 1; way < this->associativity; way++) {
+        if (values[way] > values[victim]) victim = way;
+    }
+    return victim;
+}
+
+ReplacementPolicy::Policy OPTPolicy::getPolicy() {
+    return OPT;
+}
@@ -0,0 +1,176 @@
+/*
+ * Reuse-distance histograms and LRU miss ratio curves of a trace, for every
+ * block size in one pass over it, see ReuseDistance.h.
+ * ./ReuseAnalyzer path [-b sizes] [-s rate[,maxBlocks]] [-f format] [-o file]
+ * The curves are written to ./src/analysis_mrc.csv, the histograms printed.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+#include "ReuseDistance.h"
+#include "TraceDecoder.h"
+#include "TraceReader.h"
+
+bool parseParameters(int argc, char **argv);
+void printUsage();
+void printHistogram(const ReuseDistance &analysis);
+
+const char *traceFilePath = nullptr;
+TraceReader::Format traceFormat = TraceReader::AUTO;
+const char *outputPath = "./src/analysis_mrc.csv";
+std::vector<uint32_t> blockSizes; // 32 to 256 bytes by default, the block sizes of the sweep
+bool shards = false;
+double sampleRate = 0;
+size_t maxBlocks = 8192; // blocks tracked per block size by SHARDS, 0 keeps the rate fixed
+
+int main(int argc, char **argv) {
+    if (!parseParameters(argc, argv)) {
+        printUsage();
+        return -1;
+    }
+    if (blockSizes.empty()) {
+        for (uint32_t blockSize = 32; blockSize <= 256; blockSize *= 2) blockSizes.push_back(blockSize);
+    }
+    TraceReader reader;
+    if (!reader.open(traceFilePath, traceFormat)) {
+        printf("Unable to open file %s\n", traceFilePath);
+        return -1;
+    }
+    std::vector<ReuseDistance *> analyses;
+    for (uint32_t blockSize : blockSizes) {
+        analyses.push_back(shards ? new ReuseDistance(blockSize, sampleRate, maxBlocks) : new ReuseDistance(blockSize));
+    }
+
+    // the same accesses Cache sees: reads and writes, with the sizes of TraceBuffer
+    char operation;
+    uint32_t address;
+    uint32_t size;
+    while (reader.next(&operation, &address, &size)) {
+        if (operation != 'r' && operation != 'w') continue;
+        for (ReuseDistance *analysis : analyses) {
+            analysis->access(address, TraceBuffer::roundSize(size));
+        }
+    }
+
+    std::ofstream csvFile(outputPath);
+    if (!csvFile) {
+        printf("Unable to open file %s\n", outputPath);
+        return -1;
+    }
+    csvFile << "blockSize,cacheSize,missRate" << std::endl;
+    printf("The tested trace file: %s\n", traceFilePath);
+    for (ReuseDistance *analysis : analyses) {
+        printHistogram(*analysis);
+        // up to the capacity that holds every reuse, and at least the 1MB of the sweep
+        uint32_t blockSize = analysis->getBlockSize();
+        uint64_t maxCapacity = 1ull << (analysis->getHistogram().size() - 1);
+        if (maxCapacity < 1024 * 1024 / blockSize) maxCapacity = 1024 * 1024 / blockSize;
+        for (uint64_t capacity = 1; capacity <= maxCapacity; capacity *= 2) {
+            csvFile << blockSize << "," << capacity * blockSize << "," << (float)analysis->missRatio(capacity)
+                    << std::endl;
+        }
+        delete analysis;
+    }
+    csvFile.close();
+    return 0;
+}
+
+void printHistogram(const ReuseDistance &analysis) {
+    std::vector<double> histogram = analysis.getHistogram();
+    printf("Block size %u: %llu block accesses", analysis.getBlockSize(),
+           (unsigned long long)analysis.getNumAccesses());
+    if (shards) {
+        printf(", SHARDS rate %g", analysis.getRate());
+    }
+    printf("\n\treuse distance\taccesses\n");
+    for (size_t k = 0; k < histogram.size(); k++) {
+        if (k == 0) {
+            printf("\t0\t\t%.0f\n", histogram[k]);
+        } else {
+            printf("\t%llu-%llu\t%.0f\n", 1ull << (k - 1), (1ull << k) - 1, histogram[k]);
+        }
+    }
+    printf("\tcold\t\t%.0f\n", analysis.getColdMisses());
+}
+
+// a comma-separated list of powers of 2
+bool parseBlockSizes(const char *arg) {
+    blockSizes.clear();
+    const char *p = arg;
+    while (*p != '\0') {
+        char *end;
+        unsigned long blockSize = strtoul(p, &end, 10);
+        if (end == p || blockSize == 0 || (blockSize & (blockSize - 1)) != 0 || blockSize > (1u << 30)) {
+            return false;
+        }
+        blockSizes.push_back((uint32_t)blockSize);
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return false;
+    }
+    return !blockSizes.empty();
+}
+
+// "rate" or "rate,maxBlocks"
+bool parseSampling(const char *arg) {
+    unsigned long long blocks = maxBlocks;
+    int n = sscanf(arg, "%lf,%llu", &sampleRate, &blocks);
+    if (n != 1 && n != 2) {
+        return false;
+    }
+    maxBlocks = (size_t)blocks;
+    shards = true;
+    return sampleRate > 0 && sampleRate <= 1;
+}
+
+bool parseParameters(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        // a lone "-" is the trace on stdin
+        if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            switch (argv[i][1]) {
+            case 'b':
+                if (i + 1 < argc && parseBlockSizes(argv[i + 1])) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 's':
+                if (i + 1 < argc && parseSampling(argv[i + 1])) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 'f':
+                if (i + 1 < argc && TraceDecoder::parseFormat(argv[i + 1], &traceFormat)) {
+                    i++;
+                    break;
+                }
+                return false;
+            case 'o':
+                if (i + 1 < argc) {
+                    outputPath = argv[++i];
+                    break;
+                }
+                return false;
+            default:
+                return false;
+            }
+        } else if (traceFilePath == nullptr) {
+            traceFilePath = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return traceFilePath != nullptr;
+}
+
+void printUsage() {
+    printf("Usage: ReuseAnalyzer trace-file [-b sizes] [-s rate[,maxBlocks]] [-f format] [-o file]\n");
+    printf("The trace file can be - for stdin, or a FIFO\n");
+    printf("Parameters: \n\t[-b sizes] comma-separated block sizes, 32,64,128,256 by default\n");
+    printf("\t[-s rate[,maxBlocks]] SHARDS sampling, track the blocks of a hash below rate, lowering it to keep\n");
+    printf("\t           at most maxBlocks blocks (8192 by default, 0 keeps the rate fixed), exact without -s\n");
+    printf("\t[-f format] format of the trace, auto (detected, the default), text, binary, din, lackey or champsim\n");
+    printf("\t[-o file] the miss ratio curves, ./src/analysis_mrc.csv by default\n");
+}
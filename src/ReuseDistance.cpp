@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <iterator>
+#include "ReuseDistance.h"
+
+const uint64_t ReuseDistance::HASH_RANGE;
+
+ReuseDistance::ReuseDistance(uint32_t blockSize) : ReuseDistance(blockSize, 1, 0) {
+    this->sampled = false;
+}
+
+ReuseDistance::ReuseDistance(uint32_t blockSize, double rate, size_t maxBlocks) {
+    this->offsetBits = 0;
+    while ((1u << this->offsetBits) < blockSize) this->offsetBits++;
+    this->sampled = true;
+    this->maxBlocks = maxBlocks;
+    this->threshold = (uint64_t)(rate * HASH_RANGE);
+    if (this->threshold < 1) this->threshold = 1;
+    if (this->threshold > HASH_RANGE) this->threshold = HASH_RANGE;
+    this->numAccesses = 0;
+    this->now = 0;
+    this->tree.assign(1, 0);
+    this->cold = 0;
+}
+
+void ReuseDistance::access(uint32_t addr, uint32_t size) {
+    uint32_t blockSize = 1u << this->offsetBits;
+    while (size > 0) {
+        uint32_t len = blockSize - (addr & (blockSize - 1));
+        if (len > size) len = size;
+        this->accessBlock(addr >> this->offsetBits);
+        addr += len;
+        size -= len;
+    }
+}
+
+void ReuseDistance::accessBlock(uint32_t block) {
+    this->numAccesses++;
+    uint64_t hash = 0;
+    if (this->sampled) {
+        hash = hashBlock(block);
+        if (hash >= this->threshold) return;
+    }
+    if (this->now == this->tree.size() - 1) {
+        this->renumber();
+    }
+    auto last = this->lastUse.find(block);
+    if (last != this->lastUse.end()) {
+        // the blocks accessed since are those whose last access is later
+        uint32_t distance = (uint32_t)this->lastUse.size() - this->countBefore(last->second + 1);
+        this->mark(last->second, -1);
+        last->second = this->now;
+        uint64_t estimate = distance;
+        if (this->sampled) estimate = (uint64_t)(distance / this->getRate());
+        size_t bucket = 0;
+        while (estimate >> bucket != 0) bucket++;
+        if (bucket >= this->buckets.size()) this->buckets.resize(bucket + 1, 0);
+        this->buckets[bucket]++;
+    } else {
+        this->cold++;
+        this->lastUse[block] = this->now;
+        if (this->sampled && this->maxBlocks > 0) this->tracked.insert(std::make_pair(hash, block));
+    }
+    this->mark(this->now, 1);
+    this->now++;
+    if (this->sampled && this->maxBlocks > 0 && this->tracked.size() > this->maxBlocks) {
+        this->lowerThreshold();
+    }
+}
+
+// stop tracking the blocks of the highest hash, the counts so far are scaled to the new rate
+void ReuseDistance::lowerThreshold() {
+    uint64_t newThreshold = this->tracked.rbegin()->first;
+    while (!this->tracked.empty() && this->tracked.rbegin()->first >= newThreshold) {
+        uint32_t block = this->tracked.rbegin()->second;
+        auto last = this->lastUse.find(block);
+        this->mark(last->second, -1);
+        this->lastUse.erase(last);
+        this->tracked.erase(std::prev(this->tracked.end()));
+    }
+    double scale = (double)newThreshold / this->threshold;
+    for (double &count : this->buckets) count *= scale;
+    this->cold *= scale;
+    this->threshold = newThreshold;
+}
+
+void ReuseDistance::mark(uint32_t time, int delta) {
+    for (size_t i = (size_t)time + 1; i < this->tree.size(); i += i & (0 - i)) {
+        this->tree[i] += delta;
+    }
+}
+
+uint32_t ReuseDistance::countBefore(uint32_t time) const {
+    uint32_t count = 0;
+    for (size_t i = time; i > 0; i -= i & (0 - i)) {
+        count += this->tree[i];
+    }
+    return count;
+}
+
+// number the last accesses 0, 1, ... in time order, in a tree with room for as many new times
+void ReuseDistance::renumber() {
+    std::vector<std::pair<uint32_t, uint32_t>> times; // (time, block)
+    times.reserve(this->lastUse.size());
+    for (const auto &entry : this->lastUse) {
+        times.push_back(std::make_pair(entry.second, entry.first));
+    }
+    std::sort(times.begin(), times.end());
+    size_t capacity = std::max<size_t>(2 * times.size(), 1024);
+    this->tree.assign(capacity + 1, 0);
+    for (uint32_t time = 0; time < times.size(); time++) {
+        this->lastUse[times[time].second] = time;
+        this->mark(time, 1);
+    }
+    this->now = (uint32_t)times.size();
+}
+
+uint64_t ReuseDistance::hashBlock(uint32_t block) {
+    // splitmix64 finalizer, the low bits are uniform for any set of blocks
+    uint64_t x = block + 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x & (HASH_RANGE - 1);
+}
+
+std::vector<double> ReuseDistance::getHistogram() const {
+    std::vector<double> histogram = this->buckets;
+    if (histogram.empty()) histogram.push_back(0);
+    if (this->sampled) {
+        // SHARDS-adj: the accesses the sample is missing or has in excess go to the shortest distance
+        double total = this->cold;
+        for (double count : histogram) total += count;
+        histogram[0] += this->numAccesses * this->getRate() - total;
+        if (histogram[0] < 0) histogram[0] = 0;
+    }
+    return histogram;
+}
+
+double ReuseDistance::getColdMisses() const {
+    return this->cold;
+}
+
+double ReuseDistance::missRatio(uint64_t capacity) const {
+    std::vector<double> histogram = this->getHistogram();
+    size_t hitBuckets = 0; // buckets 0 to log2(capacity) hit
+    while ((1ull << hitBuckets) < capacity) hitBuckets++;
+    double misses = this->cold;
+    double total = this->cold;
+    for (size_t k = 0; k < histogram.size(); k++) {
+        total += histogram[k];
+        if (k > hitBuckets) misses += histogram[k];
+    }
+    return total == 0 ? 0 : misses / total;
+}
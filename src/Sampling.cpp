@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstdio>
+#include "Sampling.h"
+
+namespace {
+
+// two-sided 95% quantiles of Student's t for 1 to 30 degrees of freedom, the normal one above
+const double T_95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                       2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                       2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+const double Z_95 = 1.96;
+
+double quantile95(uint64_t degrees) {
+    return degrees <= sizeof(T_95) / sizeof(T_95[0]) ? T_95[degrees - 1] : Z_95;
+}
+
+}
+
+RatioEstimator::RatioEstimator() {
+    this->n = 0;
+    this->sumX = 0;
+    this->sumY = 0;
+    this->sumXX = 0;
+    this->sumXY = 0;
+    this->sumYY = 0;
+}
+
+void RatioEstimator::add(double y, double x) {
+    this->n++;
+    this->sumX += x;
+    this->sumY += y;
+    this->sumXX += x * x;
+    this->sumXY += x * y;
+    this->sumYY += y * y;
+}
+
+Estimate RatioEstimator::estimate(double populationSize) const {
+    Estimate result = {0, 0};
+    if (this->n == 0 || this->sumX == 0) {
+        return result;
+    }
+    double r = this->sumY / this->sumX;
+    result.value = r;
+    if (this->n < 2) {
+        return result;
+    }
+    // sum of (y - r x)^2, expanded so the samples needn't be kept
+    double residual = this->sumYY - 2 * r * this->sumXY + r * r * this->sumXX;
+    if (residual < 0) residual = 0;
+    double meanX = this->sumX / this->n;
+    double fpc = populationSize > this->n ? 1 - this->n / populationSize : 0;
+    double variance = fpc * residual / (this->n - 1) / (this->n * meanX * meanX);
+    result.halfWidth = quantile95(this->n - 1) * std::sqrt(variance);
+    return result;
+}
+
+bool TimeSampling::parse(const char *arg) {
+    unsigned long long values[4] = {0, 0, 0, 1};
+    int n = sscanf(arg, "%llu,%llu,%llu,%llu", &values[0], &values[1], &values[2], &values[3]);
+    if (n < 2) {
+        return false;
+    }
+    this->unit = values[0];
+    this->period = values[1];
+    this->warmup = n >= 3 ? values[2] : values[0];
+    this->functionalWarming = values[3] != 0;
+    return this->unit > 0 && this->unit + this->warmup <= this->period && values[3] <= 1;
+}
+
+void TimeSampler::endUnit(const CacheStats &stats, uint64_t numRecords) {
+    CacheStats unit = stats - this->before;
+    this->misses.add((double)unit.numMiss(), (double)unit.numAccesses());
+    this->cycles.add((double)(unit.baseCycles + unit.missCycles), (double)numRecords);
+}
+
+void TimeSampler::estimate(const TimeSampling &sampling, uint64_t length, Estimate *missRate, Estimate *cpi) const {
+    double numUnits = (double)length / sampling.unit;
+    *missRate = this->misses.estimate(numUnits);
+    *cpi = this->cycles.estimate(numUnits);
+}
+
+void estimateSetSampled(Cache *cache, uint64_t length, Estimate *missRate, Estimate *cpi) {
+    if (!cache->isSetSampling()) {
+        // every set was simulated
+        missRate->value = cache->stats.missRate();
+        missRate->halfWidth = 0;
+        cpi->value = length == 0 ? 0 : (double)(cache->stats.baseCycles + cache->stats.missCycles) / length;
+        cpi->halfWidth = 0;
+        return;
+    }
+    RatioEstimator misses;
+    RatioEstimator cycles;
+    uint32_t numSets = cache->getNumSets();
+    for (uint32_t set = 0; set < numSets; set++) {
+        if (!cache->isSampledSet(set)) continue;
+        uint64_t accesses;
+        uint64_t setMisses;
+        uint64_t setCycles;
+        cache->getSetCounts(set, &accesses, &setMisses, &setCycles);
+        misses.add((double)setMisses, (double)accesses);
+        cycles.add((double)setCycles, 1);
+    }
+    *missRate = misses.estimate(numSets);
+    // the mean cycles of a set, times the number of sets, per record
+    Estimate perSet = cycles.estimate(numSets);
+    double scale = length == 0 ? 0 : (double)numSets / length;
+    cpi->value = perSet.value * scale;
+    cpi->halfWidth = perSet.halfWidth * scale;
+}
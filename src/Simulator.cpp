@@ -1264,7 +1264,8 @@ void Simulator::printStatistics() {
   // std::cout << "cycle count: " << this->history.cycleCount << std::endl;
   if (this->memory->cache != nullptr) {
     printf("----Run with Cache----\n");
-    printf("Number of Cycles: %u\n", this->history.cycleCount + this->memory->cache->get_total_cycles());
+    printf("Number of Cycles: %llu\n",
+           (unsigned long long)(this->history.cycleCount + this->memory->cache->get_total_cycles()));
     printf("Avg Cycles per Instrcution: %.4f\n",
          (float)(this->history.cycleCount + this->memory->cache->get_total_cycles()) / this->history.instCount);
   } else {
@@ -1283,7 +1284,9 @@ void Simulator::printStatistics() {
   printf("Number of Memory Hazards: %u\n",
          this->history.memoryHazardCount);
   printf("-----------------------------------\n");
-  //this->memory->printStatistics();
+  if (this->memory->cache != nullptr) {
+    this->memory->printStatistics();
+  }
 }
 
 std::string Simulator::getRegInfoStr() {
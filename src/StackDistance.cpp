@@ -0,0 +1,83 @@
+#include "StackDistance.h"
+
+StackDistance::StackDistance(uint32_t numSets, uint32_t blockSize, uint32_t maxWays) {
+    this->numSets = numSets;
+    this->offsetBits = 0;
+    while ((1u << this->offsetBits) < blockSize) this->offsetBits++;
+    this->maxWays = maxWays;
+    this->blocks.assign((size_t)numSets * maxWays, 0);
+    this->dirtyFrom.assign((size_t)numSets * maxWays, maxWays + 1);
+    this->depth.assign(numSets, 0);
+    this->readHits.assign(maxWays, 0);
+    this->writeHits.assign(maxWays, 0);
+    this->dirtyEvictions.assign(maxWays, 0);
+    this->numReads = 0;
+    this->numWrites = 0;
+}
+
+void StackDistance::access(uint32_t addr, uint32_t size, bool isWrite) {
+    uint32_t blockSize = 1u << this->offsetBits;
+    while (size > 0) {
+        uint32_t len = blockSize - (addr & (blockSize - 1));
+        if (len > size) len = size;
+        this->accessBlock(addr >> this->offsetBits, isWrite);
+        addr += len;
+        size -= len;
+    }
+}
+
+void StackDistance::accessBlock(uint32_t block, bool isWrite) {
+    uint32_t set = block & (this->numSets - 1);
+    uint32_t *stack = &this->blocks[(size_t)set * this->maxWays];
+    uint8_t *dirty = &this->dirtyFrom[(size_t)set * this->maxWays];
+    uint32_t n = this->depth[set];
+    uint32_t pos = 0;
+    while (pos < n && stack[pos] != block) pos++;
+    bool found = pos < n;
+
+    // the caches with fewer ways than the stack distance miss, each evicts the
+    // entry at the depth of its ways if its set is full
+    for (uint32_t ways = 1; ways <= pos; ways++) {
+        if (dirty[ways - 1] <= ways) this->dirtyEvictions[ways - 1]++;
+    }
+
+    uint8_t threshold;
+    if (isWrite) {
+        this->numWrites++;
+        if (found) this->writeHits[pos]++;
+        threshold = 1;
+    } else {
+        this->numReads++;
+        if (found) this->readHits[pos]++;
+        threshold = found ? (dirty[pos] > pos + 1 ? dirty[pos] : pos + 1) : this->maxWays + 1;
+    }
+
+    // move the block to the top, a new block pushes out the bottom entry of a full stack
+    if (!found) {
+        if (n < this->maxWays) this->depth[set] = ++n;
+        pos = n - 1;
+    }
+    for (uint32_t i = pos; i > 0; i--) {
+        stack[i] = stack[i - 1];
+        dirty[i] = dirty[i - 1];
+    }
+    stack[0] = block;
+    dirty[0] = threshold;
+}
+
+CacheStats StackDistance::getStats(uint32_t ways, bool writeBack, uint32_t hitLatency, uint32_t missLatency) {
+    CacheStats stats;
+    for (uint32_t d = 0; d < ways && d < this->maxWays; d++) {
+        stats.numReadHit += this->readHits[d];
+        stats.numWriteHit += this->writeHits[d];
+    }
+    stats.numReadMiss = this->numReads - stats.numReadHit;
+    stats.numWriteMiss = this->numWrites - stats.numWriteHit;
+    stats.numFill = stats.numMiss();
+    stats.numWriteback = this->dirtyEvictions[ways - 1];
+    stats.baseCycles = (this->numReads + this->numWrites) * hitLatency;
+    // write-through caches also write every write hit to the lower level
+    uint64_t numLowerAccesses = stats.numFill + stats.numWriteback + (writeBack ? 0 : stats.numWriteHit);
+    stats.missCycles = numLowerAccesses * missLatency;
+    return stats;
+}
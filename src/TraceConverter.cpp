@@ -0,0 +1,55 @@
+/*
+ * Converts a text memory trace to the binary trace format, see TraceReader.h
+ * ./TraceConverter input.trace output.bin [format]
+ * Either path can be "-" for stdin or stdout, to convert a trace on its way
+ * from a producer to the simulators.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "TraceDecoder.h"
+#include "TraceReader.h"
+
+void printUsage();
+
+int main(int argc, char **argv) {
+    TraceReader::Format format = TraceReader::AUTO;
+    if ((argc != 3 && argc != 4) || (argc == 4 && !TraceDecoder::parseFormat(argv[3], &format))) {
+        printUsage();
+        return -1;
+    }
+    TraceReader reader;
+    if (!reader.open(argv[1], format)) {
+        printf("Unable to open file %s\n", argv[1]);
+        return -1;
+    }
+    TraceWriter writer;
+    if (!writer.open(argv[2])) {
+        printf("Unable to open file %s\n", argv[2]);
+        return -1;
+    }
+
+    char operation;
+    uint32_t address;
+    uint32_t size;
+    while (reader.next(&operation, &address, &size)) {
+        writer.write(operation, address, size);
+    }
+    uint64_t numRecords = writer.getNumRecords();
+    if (!writer.close()) {
+        printf("Unable to write file %s\n", argv[2]);
+        return -1;
+    }
+    // the records themselves go to stdout with "-"
+    if (strcmp(argv[2], "-") != 0) {
+        printf("Converted %llu records\n", (unsigned long long)numRecords);
+    }
+    return 0;
+}
+
+void printUsage() {
+    printf("Usage: TraceConverter input-trace output-trace [format]\n");
+    printf("The input is a trace of any format read by the simulators, the output is a binary trace\n");
+    printf("The format of the input is auto (detected, the default), text, binary, din, lackey or champsim\n");
+    printf("Either can be - for stdin or stdout\n");
+}
@@ -0,0 +1,245 @@
+#include <cstring>
+#include "TraceDecoder.h"
+
+const uint32_t TraceDecoder::MAX_ACCESSES;
+const size_t ChampSimDecoder::RECORD_SIZE;
+
+namespace {
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// the line at pos, without its newline. False at the end of the window, or
+// if the line is cut by it and the window isn't the last one
+inline bool getLine(const char *pos, const char *end, bool lastWindow, const char **lineEnd, const char **next) {
+    if (pos == end) return false;
+    const char *newline = (const char *)memchr(pos, '\n', end - pos);
+    if (newline == nullptr) {
+        if (!lastWindow) return false;
+        *lineEnd = end;
+        *next = end;
+        return true;
+    }
+    *lineEnd = newline;
+    *next = newline + 1;
+    return true;
+}
+
+// a hex number with an optional 0x prefix, kept to its low 32 bits
+inline bool parseHex(const char **pos, const char *end, uint32_t *value) {
+    const char *p = *pos;
+    if (end - p >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x') p += 2;
+    const char *digits = p;
+    uint32_t v = 0;
+    int digit;
+    while (p < end && (digit = hexValue(*p)) >= 0) {
+        v = (v << 4) | (uint32_t)digit;
+        p++;
+    }
+    if (p == digits) return false;
+    *value = v;
+    *pos = p;
+    return true;
+}
+
+inline bool parseDecimal(const char **pos, const char *end, uint32_t *value) {
+    const char *p = *pos;
+    uint32_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (uint32_t)(*p - '0');
+        p++;
+    }
+    if (p == *pos) return false;
+    *value = v;
+    *pos = p;
+    return true;
+}
+
+inline uint64_t load64(const char *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+}
+
+TraceDecoder *TraceDecoder::create(TraceReader::Format format) {
+    switch (format) {
+    case TraceReader::DINERO:
+        return new DineroDecoder();
+    case TraceReader::LACKEY:
+        return new LackeyDecoder();
+    case TraceReader::CHAMPSIM:
+        return new ChampSimDecoder();
+    default:
+        return nullptr;
+    }
+}
+
+TraceReader::Format TraceDecoder::detect(const char *path, const char *head, size_t length) {
+    // ChampSim traces are raw structs, only their name tells them apart
+    if (strstr(path, ".champsim") != nullptr) {
+        return TraceReader::CHAMPSIM;
+    }
+    const char *p = head;
+    const char *end = head + length;
+    const char *lineEnd;
+    const char *next;
+    while (getLine(p, end, true, &lineEnd, &next)) {
+        const char *q = p;
+        p = next;
+        if (lineEnd - q >= 2 && q[0] == '=' && q[1] == '=') continue; // the valgrind banner
+        if (lineEnd - q >= 2 && q[0] == 'I' && q[1] == ' ') return TraceReader::LACKEY;
+        if (lineEnd - q >= 3 && q[0] == ' ' && (q[1] == 'L' || q[1] == 'S' || q[1] == 'M') && q[2] == ' ') {
+            return TraceReader::LACKEY;
+        }
+        while (q < lineEnd && isBlank(*q)) q++;
+        if (q == lineEnd) continue;
+        if (lineEnd - q >= 2 && *q >= '0' && *q <= '9' && isBlank(q[1])) return TraceReader::DINERO;
+        break;
+    }
+    return TraceReader::TEXT;
+}
+
+bool TraceDecoder::parseFormat(const std::string &name, TraceReader::Format *format) {
+    const TraceReader::Format all[] = {TraceReader::TEXT,   TraceReader::BINARY,   TraceReader::DINERO,
+                                       TraceReader::LACKEY, TraceReader::CHAMPSIM, TraceReader::AUTO};
+    for (TraceReader::Format f : all) {
+        if (name == formatName(f)) {
+            *format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string TraceDecoder::formatName(TraceReader::Format format) {
+    switch (format) {
+    case TraceReader::TEXT: return "text";
+    case TraceReader::BINARY: return "binary";
+    case TraceReader::DINERO: return "din";
+    case TraceReader::LACKEY: return "lackey";
+    case TraceReader::CHAMPSIM: return "champsim";
+    case TraceReader::AUTO: return "auto";
+    }
+    return "error";
+}
+
+bool DineroDecoder::decode(const char **pos, const char *end, bool lastWindow, TraceAccess *accesses,
+                           uint32_t *count) {
+    const char *p = *pos;
+    const char *lineEnd;
+    const char *next;
+    while (getLine(p, end, lastWindow, &lineEnd, &next)) {
+        const char *q = p;
+        p = next;
+        while (q < lineEnd && isBlank(*q)) q++;
+        if (q == lineEnd) continue;
+        char label = *q++;
+        if (q == lineEnd || !isBlank(*q)) return false;
+        while (q < lineEnd && isBlank(*q)) q++;
+        uint32_t address;
+        if (!parseHex(&q, lineEnd, &address)) return false;
+        TraceAccess access = {0, address, 1, this->pc};
+        switch (label) {
+        case '0':
+            access.operation = 'r';
+            break;
+        case '1':
+            access.operation = 'w';
+            break;
+        case '2':
+            access.operation = 'i';
+            access.pc = address;
+            break;
+        case '3':
+        case '4':
+            continue;
+        default:
+            return false;
+        }
+        this->pc = access.pc;
+        accesses[0] = access;
+        *count = 1;
+        *pos = p;
+        return true;
+    }
+    return false;
+}
+
+bool LackeyDecoder::decode(const char **pos, const char *end, bool lastWindow, TraceAccess *accesses,
+                           uint32_t *count) {
+    const char *p = *pos;
+    const char *lineEnd;
+    const char *next;
+    while (getLine(p, end, lastWindow, &lineEnd, &next)) {
+        const char *q = p;
+        p = next;
+        char kind;
+        if (lineEnd - q >= 2 && q[0] == 'I' && q[1] == ' ') {
+            kind = 'I';
+            q += 2;
+        } else if (lineEnd - q >= 3 && q[0] == ' ' && (q[1] == 'L' || q[1] == 'S' || q[1] == 'M') && q[2] == ' ') {
+            kind = q[1];
+            q += 3;
+        } else {
+            continue;
+        }
+        while (q < lineEnd && isBlank(*q)) q++;
+        uint32_t address;
+        uint32_t size;
+        if (!parseHex(&q, lineEnd, &address) || q == lineEnd || *q++ != ',' || !parseDecimal(&q, lineEnd, &size)) {
+            return false;
+        }
+        uint32_t n = 0;
+        switch (kind) {
+        case 'I':
+            this->pc = address;
+            accesses[n++] = {'i', address, size, address};
+            break;
+        case 'L':
+            accesses[n++] = {'r', address, size, this->pc};
+            break;
+        case 'S':
+            accesses[n++] = {'w', address, size, this->pc};
+            break;
+        case 'M':
+            accesses[n++] = {'r', address, size, this->pc};
+            accesses[n++] = {'w', address, size, this->pc};
+            break;
+        }
+        *count = n;
+        *pos = p;
+        return true;
+    }
+    return false;
+}
+
+bool ChampSimDecoder::decode(const char **pos, const char *end, bool /*lastWindow*/, TraceAccess *accesses,
+                             uint32_t *count) {
+    // ip at 0, destination_memory[2] at 16, source_memory[4] at 32
+    if ((size_t)(end - *pos) < RECORD_SIZE) return false;
+    const char *record = *pos;
+    uint32_t ip = (uint32_t)load64(record);
+    uint32_t n = 0;
+    accesses[n++] = {'i', ip, 1, ip};
+    for (int i = 0; i < 4; i++) {
+        uint64_t address = load64(record + 32 + 8 * i);
+        if (address != 0) accesses[n++] = {'r', (uint32_t)address, 1, ip};
+    }
+    for (int i = 0; i < 2; i++) {
+        uint64_t address = load64(record + 16 + 8 * i);
+        if (address != 0) accesses[n++] = {'w', (uint32_t)address, 1, ip};
+    }
+    *count = n;
+    *pos = record + RECORD_SIZE;
+    return true;
+}
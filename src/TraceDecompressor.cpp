@@ -0,0 +1,355 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#if defined(TRACE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(TRACE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(TRACE_LZMA)
+#include <lzma.h>
+#endif
+#include "TraceDecompressor.h"
+
+const size_t TraceDecompressor::CHUNK_SIZE;
+const size_t TraceDecompressor::NUM_CHUNKS;
+const size_t TraceDecompressor::INPUT_SIZE;
+const size_t TraceDecompressor::MAGIC_SIZE;
+
+namespace {
+
+// the compressed pages already read are dropped every DROP_SIZE bytes
+const uint64_t DROP_SIZE = 64 * 1024 * 1024;
+// a pipe quiet for this long hands over the partial chunk
+const int FLUSH_DELAY_MS = 1;
+
+}
+
+TraceDecompressor::TraceDecompressor() : fullChunks(NUM_CHUNKS), freeChunks(NUM_CHUNKS) {
+    this->fd = -1;
+    this->codec = NONE;
+    this->headPos = 0;
+    this->inputOffset = 0;
+    this->stopping.store(false);
+    this->error.store(false);
+    this->outChunk = 0;
+    this->outLength = 0;
+    this->currentChunk = -1;
+    this->done = false;
+}
+
+TraceDecompressor::~TraceDecompressor() {
+    this->stopping.store(true);
+    // wakes the thread blocked on a free chunk
+    this->freeChunks.close();
+    if (this->thread.joinable()) {
+        this->thread.join();
+    }
+}
+
+TraceDecompressor::Codec TraceDecompressor::detect(const uint8_t *head, size_t length) {
+    static const uint8_t GZIP_MAGIC[] = {0x1f, 0x8b};
+    static const uint8_t ZSTD_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+    static const uint8_t XZ_MAGIC[] = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+    if (length >= sizeof(GZIP_MAGIC) && memcmp(head, GZIP_MAGIC, sizeof(GZIP_MAGIC)) == 0) return GZIP;
+    if (length >= sizeof(ZSTD_MAGIC) && memcmp(head, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0) return ZSTD;
+    if (length >= sizeof(XZ_MAGIC) && memcmp(head, XZ_MAGIC, sizeof(XZ_MAGIC)) == 0) return XZ;
+    return NONE;
+}
+
+bool TraceDecompressor::isSupported(Codec codec) {
+    switch (codec) {
+    case NONE:
+        return true;
+#if defined(TRACE_ZLIB)
+    case GZIP:
+        return true;
+#endif
+#if defined(TRACE_ZSTD)
+    case ZSTD:
+        return true;
+#endif
+#if defined(TRACE_LZMA)
+    case XZ:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+const char *TraceDecompressor::getName(Codec codec) {
+    switch (codec) {
+    case GZIP:
+        return "gzip";
+    case ZSTD:
+        return "zstd";
+    case XZ:
+        return "xz";
+    default:
+        return "uncompressed";
+    }
+}
+
+bool TraceDecompressor::start(int fd, Codec codec, const uint8_t *head, size_t headLength) {
+    if (!isSupported(codec) || this->thread.joinable()) {
+        return false;
+    }
+    this->fd = fd;
+    this->codec = codec;
+    this->head.assign(head, head + headLength);
+    this->headPos = 0;
+    if (codec != NONE) this->input.resize(INPUT_SIZE);
+    this->chunks.resize(NUM_CHUNKS);
+    this->chunkLengths.assign(NUM_CHUNKS, 0);
+    this->chunkLast.assign(NUM_CHUNKS, 0);
+    for (uint32_t i = 0; i < NUM_CHUNKS; i++) {
+        this->chunks[i].resize(CHUNK_SIZE);
+        this->freeChunks.push(i);
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    this->thread = std::thread(&TraceDecompressor::run, this);
+    return true;
+}
+
+const char *TraceDecompressor::nextChunk(size_t *length, bool *last) {
+    if (this->currentChunk >= 0) {
+        this->freeChunks.push(this->currentChunk);
+        this->currentChunk = -1;
+    }
+    uint32_t chunk;
+    // the thread always ends with a last chunk, so the queue needs no close()
+    if (this->done || !this->fullChunks.pop(&chunk)) {
+        return nullptr;
+    }
+    this->currentChunk = chunk;
+    *length = this->chunkLengths[chunk];
+    *last = this->chunkLast[chunk] != 0;
+    this->done = *last;
+    return this->chunks[chunk].data();
+}
+
+void TraceDecompressor::run() {
+    if (!this->acquireChunk()) return;
+    bool ok = false;
+    switch (this->codec) {
+    case NONE:
+        ok = this->runCopy();
+        break;
+#if defined(TRACE_ZLIB)
+    case GZIP:
+        ok = this->runGzip();
+        break;
+#endif
+#if defined(TRACE_ZSTD)
+    case ZSTD:
+        ok = this->runZstd();
+        break;
+#endif
+#if defined(TRACE_LZMA)
+    case XZ:
+        ok = this->runXz();
+        break;
+#endif
+    default:
+        break;
+    }
+    if (this->stopping.load()) return;
+    if (!ok) {
+        this->error.store(true);
+        printf("Corrupt or unreadable %s trace\n", this->codec == NONE ? "streamed" : getName(this->codec));
+    }
+    this->pushChunk(true);
+}
+
+long TraceDecompressor::readFile(void *dest, size_t length) {
+    if (this->headPos < this->head.size()) {
+        size_t n = this->head.size() - this->headPos < length ? this->head.size() - this->headPos : length;
+        memcpy(dest, this->head.data() + this->headPos, n);
+        this->headPos += n;
+        return n;
+    }
+    ssize_t n;
+    do {
+        n = read(this->fd, dest, length);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) {
+        uint64_t before = this->inputOffset;
+        this->inputOffset += n;
+#if defined(POSIX_FADV_DONTNEED)
+        if (this->inputOffset / DROP_SIZE != before / DROP_SIZE) {
+            posix_fadvise(this->fd, 0, this->inputOffset, POSIX_FADV_DONTNEED);
+        }
+#endif
+    }
+    return n;
+}
+
+// blocks while the reader holds every chunk
+bool TraceDecompressor::acquireChunk() {
+    if (this->stopping.load() || !this->freeChunks.pop(&this->outChunk)) {
+        return false;
+    }
+    this->outLength = 0;
+    return true;
+}
+
+void TraceDecompressor::pushChunk(bool last) {
+    this->chunkLengths[this->outChunk] = this->outLength;
+    this->chunkLast[this->outChunk] = last;
+    this->fullChunks.push(this->outChunk);
+}
+
+// the input is copied as it is, a chunk goes to the reader once full or
+// once the pipe has had nothing more for FLUSH_DELAY_MS, read() then blocks
+// until the producer writes again
+bool TraceDecompressor::runCopy() {
+    for (;;) {
+        long n = this->readFile(this->chunks[this->outChunk].data() + this->outLength, CHUNK_SIZE - this->outLength);
+        if (n <= 0) {
+            return n == 0;
+        }
+        this->outLength += n;
+        struct pollfd ready = {this->fd, POLLIN, 0};
+        if (this->outLength == CHUNK_SIZE || (this->headPos == this->head.size() && poll(&ready, 1, FLUSH_DELAY_MS) == 0)) {
+            this->pushChunk(false);
+            if (!this->acquireChunk()) return true;
+        }
+    }
+}
+
+// each codec below returns false on a corrupt or truncated stream. When the
+// chunk fills up the decoder may still hold output, so the end of the input
+// only counts once a call left room in the chunk
+
+#if defined(TRACE_ZLIB)
+bool TraceDecompressor::runGzip() {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    // 16: gzip wrapper only
+    if (inflateInit2(&z, 15 + 16) != Z_OK) {
+        return false;
+    }
+    bool ok = false;
+    bool streamEnd = false;
+    bool flushing = false;
+    for (;;) {
+        if (z.avail_in == 0 && !flushing) {
+            long n = this->readInput();
+            if (n <= 0) {
+                ok = n == 0 && streamEnd;
+                break;
+            }
+            z.next_in = this->input.data();
+            z.avail_in = n;
+        }
+        // gzip -d also reads concatenated members
+        if (streamEnd && z.avail_in > 0) {
+            inflateReset(&z);
+            streamEnd = false;
+        }
+        z.next_out = (Bytef *)this->chunks[this->outChunk].data() + this->outLength;
+        z.avail_out = CHUNK_SIZE - this->outLength;
+        int status = inflate(&z, Z_NO_FLUSH);
+        this->outLength = CHUNK_SIZE - z.avail_out;
+        if (status == Z_STREAM_END) {
+            streamEnd = true;
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            break;
+        }
+        flushing = this->outLength == CHUNK_SIZE;
+        if (flushing) {
+            this->pushChunk(false);
+            if (!this->acquireChunk()) break;
+        }
+    }
+    inflateEnd(&z);
+    return ok;
+}
+#endif
+
+#if defined(TRACE_ZSTD)
+bool TraceDecompressor::runZstd() {
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    if (stream == nullptr || ZSTD_isError(ZSTD_initDStream(stream))) {
+        ZSTD_freeDStream(stream);
+        return false;
+    }
+    ZSTD_inBuffer in = {this->input.data(), 0, 0};
+    size_t pending = 0; // nonzero while a frame is unfinished
+    bool ok = false;
+    bool flushing = false;
+    for (;;) {
+        if (in.pos == in.size && !flushing) {
+            long n = this->readInput();
+            if (n <= 0) {
+                ok = n == 0 && pending == 0;
+                break;
+            }
+            in.size = n;
+            in.pos = 0;
+        }
+        ZSTD_outBuffer out = {this->chunks[this->outChunk].data(), CHUNK_SIZE, this->outLength};
+        size_t result = ZSTD_decompressStream(stream, &out, &in);
+        if (ZSTD_isError(result)) {
+            break;
+        }
+        pending = result;
+        this->outLength = out.pos;
+        flushing = this->outLength == CHUNK_SIZE;
+        if (flushing) {
+            this->pushChunk(false);
+            if (!this->acquireChunk()) break;
+        }
+    }
+    ZSTD_freeDStream(stream);
+    return ok;
+}
+#endif
+
+#if defined(TRACE_LZMA)
+bool TraceDecompressor::runXz() {
+    lzma_stream stream = LZMA_STREAM_INIT;
+    if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+        return false;
+    }
+    // LZMA_FINISH at the end of the input, the decoder then reports the end of the stream
+    lzma_action action = LZMA_RUN;
+    bool ok = false;
+    for (;;) {
+        if (stream.avail_in == 0 && action == LZMA_RUN) {
+            long n = this->readInput();
+            if (n < 0) break;
+            if (n == 0) {
+                action = LZMA_FINISH;
+            } else {
+                stream.next_in = this->input.data();
+                stream.avail_in = n;
+            }
+        }
+        stream.next_out = (uint8_t *)this->chunks[this->outChunk].data() + this->outLength;
+        stream.avail_out = CHUNK_SIZE - this->outLength;
+        lzma_ret result = lzma_code(&stream, action);
+        this->outLength = CHUNK_SIZE - stream.avail_out;
+        if (result == LZMA_STREAM_END) {
+            ok = true;
+            break;
+        }
+        if (result != LZMA_OK) {
+            break;
+        }
+        if (this->outLength == CHUNK_SIZE) {
+            this->pushChunk(false);
+            if (!this->acquireChunk()) break;
+        }
+    }
+    lzma_end(&stream);
+    return ok;
+}
+#endif
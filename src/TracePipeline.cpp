@@ -0,0 +1,84 @@
+#include "TracePipeline.h"
+
+const size_t TracePipeline::BATCH_SIZE;
+const size_t TracePipeline::NUM_BATCHES;
+
+TracePipeline::TracePipeline() : fullBatches(NUM_BATCHES), freeBatches(NUM_BATCHES) {
+    this->batches.resize(NUM_BATCHES);
+    this->batchCounts.assign(NUM_BATCHES, 0);
+    this->stopping.store(false);
+    this->currentBatch = -1;
+    this->numRecords = 0;
+}
+
+TracePipeline::~TracePipeline() {
+    this->stopping.store(true);
+    // wakes a reader blocked on a free batch
+    this->freeBatches.close();
+    if (this->readerThread.joinable()) {
+        this->readerThread.join();
+    }
+}
+
+bool TracePipeline::open(const char *path, TraceReader::Format format) {
+    if (!this->reader.open(path, format)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < NUM_BATCHES; i++) {
+        this->batches[i].resize(BATCH_SIZE);
+        this->freeBatches.push(i);
+    }
+    this->readerThread = std::thread(&TracePipeline::readerLoop, this);
+    return true;
+}
+
+void TracePipeline::readerLoop() {
+    bool more = true;
+    while (more) {
+        // blocks while the consumer holds every batch
+        uint32_t batch;
+        if (this->stopping.load() || !this->freeBatches.pop(&batch)) {
+            return;
+        }
+        TraceRecord *records = this->batches[batch].data();
+        size_t count = 0;
+        char operation;
+        uint32_t address;
+        uint32_t size;
+        uint32_t pc;
+        while (count < BATCH_SIZE && (more = this->reader.next(&operation, &address, &size, &pc))) {
+            records[count].address = address;
+            records[count].pc = pc;
+            records[count].operation = operation == 'r' ? TraceBuffer::READ : operation == 'w' ? TraceBuffer::WRITE
+                                                                                          : TraceBuffer::OTHER;
+            // rounded like TraceBuffer, so streamed and loaded runs see the same accesses
+            records[count].size = (uint8_t)TraceBuffer::roundSize(size);
+            count++;
+        }
+        this->batchCounts[batch] = count;
+        if (count > 0) {
+            this->fullBatches.push(batch);
+        }
+    }
+    this->fullBatches.close();
+}
+
+const TraceRecord *TracePipeline::nextBatch(size_t *count) {
+    if (this->currentBatch >= 0) {
+        this->freeBatches.push(this->currentBatch);
+        this->currentBatch = -1;
+    }
+    uint32_t batch;
+    if (!this->fullBatches.pop(&batch)) {
+        return nullptr;
+    }
+    this->currentBatch = batch;
+    *count = this->batchCounts[batch];
+    this->numRecords += *count;
+    const TraceRecord *records = this->batches[batch].data();
+    // the batch was written on the reader's core, start pulling its first lines over
+    for (size_t i = 0; i < 8 * 64 / sizeof(TraceRecord) && i < *count; i += 64 / sizeof(TraceRecord)) {
+        __builtin_prefetch(&records[i]);
+    }
+    return records;
+}
@@ -0,0 +1,476 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#include "TraceDecoder.h"
+#include "TraceReader.h"
+
+const size_t TraceReader::WINDOW_SIZE;
+const char TraceWriter::MAGIC[8] = {'M', 'T', 'R', 'A', 'C', 'E', 'B', '\0'};
+const uint32_t TraceWriter::VERSION;
+const size_t TraceWriter::HEADER_SIZE;
+
+namespace {
+
+// character classes of the "C" locale, looked up instead of branching on ranges
+struct CharTables
+{
+    int8_t hex[256]; // value of a hex digit, -1 otherwise
+    bool space[256];
+
+    CharTables() {
+        for (int c = 0; c < 256; c++) {
+            this->hex[c] = -1;
+            this->space[c] = c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+        }
+        for (int c = '0'; c <= '9'; c++) this->hex[c] = c - '0';
+        for (int c = 'a'; c <= 'f'; c++) this->hex[c] = c - 'a' + 10;
+        for (int c = 'A'; c <= 'F'; c++) this->hex[c] = c - 'A' + 10;
+    }
+};
+
+const CharTables tables;
+
+}
+
+TraceReader::TraceReader() {
+    this->fd = -1;
+    this->format = TEXT;
+    this->fileSize = 0;
+    this->windowOffset = 0;
+    this->window = nullptr;
+    this->windowLength = 0;
+    this->cur = nullptr;
+    this->end = nullptr;
+    this->lastWindow = true;
+    this->prevAddress = 0;
+    this->seekable = false;
+    this->codec = TraceDecompressor::NONE;
+    this->decompressor = nullptr;
+    this->decoder = nullptr;
+    this->numPending = 0;
+    this->pendingPos = 0;
+}
+
+TraceReader::~TraceReader() {
+    this->close();
+}
+
+bool TraceReader::open(const char *path, Format format) {
+    this->close();
+    this->fd = strcmp(path, "-") == 0 ? dup(STDIN_FILENO) : ::open(path, O_RDONLY);
+    if (this->fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(this->fd, &st) != 0) {
+        this->close();
+        return false;
+    }
+    this->fileSize = st.st_size;
+    this->seekable = S_ISREG(st.st_mode);
+    // the head of a pipe can't be read again, it is handed to the decompressor
+    uint8_t head[TraceDecompressor::MAGIC_SIZE];
+    size_t headLength = 0;
+    if (this->seekable) {
+        ssize_t n = pread(this->fd, head, sizeof(head), 0);
+        headLength = n > 0 ? n : 0;
+    } else {
+        while (headLength < sizeof(head)) {
+            ssize_t n = read(this->fd, head + headLength, sizeof(head) - headLength);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            headLength += n;
+        }
+    }
+    this->codec = TraceDecompressor::detect(head, headLength);
+    if (this->codec != TraceDecompressor::NONE || !this->seekable) {
+        if (!TraceDecompressor::isSupported(this->codec)) {
+            printf("Reading %s traces is not compiled in\n", TraceDecompressor::getName(this->codec));
+            this->close();
+            return false;
+        }
+        if (!this->startDecompressor(this->seekable ? nullptr : head, this->seekable ? 0 : headLength)) {
+            this->close();
+            return false;
+        }
+    } else {
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(this->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        if (!this->mapWindow(0)) {
+            this->close();
+            return false;
+        }
+    }
+    this->prevAddress = 0;
+    bool magic = (size_t)(this->end - this->window) >= TraceWriter::HEADER_SIZE &&
+                 memcmp(this->window, TraceWriter::MAGIC, sizeof(TraceWriter::MAGIC)) == 0;
+    if (magic && (format == AUTO || format == BINARY)) {
+        uint32_t version;
+        memcpy(&version, this->window + sizeof(TraceWriter::MAGIC), sizeof(version));
+        if (version != TraceWriter::VERSION) {
+            this->close();
+            return false;
+        }
+        this->format = BINARY;
+        this->cur += TraceWriter::HEADER_SIZE;
+    } else if (format == BINARY) {
+        this->close();
+        return false;
+    } else {
+        this->format = format == AUTO ? TraceDecoder::detect(path, this->window, this->end - this->window) : format;
+    }
+    this->decoder = TraceDecoder::create(this->format);
+    return true;
+}
+
+void TraceReader::close() {
+    delete this->decoder;
+    this->decoder = nullptr;
+    this->numPending = 0;
+    this->pendingPos = 0;
+    this->unmapWindow();
+    // the decompressor reads fd until it is stopped
+    delete this->decompressor;
+    this->decompressor = nullptr;
+    this->codec = TraceDecompressor::NONE;
+    this->seekable = false;
+    if (this->fd >= 0) {
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    this->fileSize = 0;
+}
+
+bool TraceReader::rewind() {
+    this->prevAddress = 0;
+    if (this->fd < 0 || !this->seekable) {
+        return false;
+    }
+    if (this->decoder != nullptr) {
+        delete this->decoder;
+        this->decoder = TraceDecoder::create(this->format);
+        this->numPending = 0;
+        this->pendingPos = 0;
+    }
+    if (this->decompressor == nullptr) {
+        return this->mapWindow(this->format == BINARY ? TraceWriter::HEADER_SIZE : 0);
+    }
+    if (!this->startDecompressor()) {
+        return false;
+    }
+    if (this->format == BINARY) this->cur += TraceWriter::HEADER_SIZE;
+    return true;
+}
+
+inline bool TraceReader::parseRecord(const char **pos, const char *end, bool lastWindow, char *operation,
+                                     uint32_t *address) {
+    const uint8_t *p = (const uint8_t *)*pos;
+    const uint8_t *e = (const uint8_t *)end;
+    while (p < e && tables.space[*p]) p++;
+    if (p == e) return false;
+    *operation = (char)*p++;
+    while (p < e && tables.space[*p]) p++;
+    // the 0x prefix needs two bytes to be recognized
+    if (e - p < 2 && !lastWindow) return false;
+    if (e - p >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x') p += 2;
+    const uint8_t *digits = p;
+    uint32_t value = 0;
+    int8_t digit;
+    while (p < e && (digit = tables.hex[*p]) >= 0) {
+        value = (value << 4) | (uint32_t)digit;
+        p++;
+    }
+    // the number may continue in the next window
+    if (p == digits || (p == e && !lastWindow)) return false;
+    *address = value;
+    *pos = (const char *)p;
+    return true;
+}
+
+// cur and prevAddress only move when a whole record is decoded
+inline bool TraceReader::decodeRecord(char *operation, uint32_t *address, uint32_t *size) {
+    const uint8_t *p = (const uint8_t *)this->cur;
+    const uint8_t *e = (const uint8_t *)this->end;
+    if (p == e) return false;
+    uint8_t tag = *p++;
+    switch (tag & 3) {
+    case 0:
+        *operation = 'r';
+        break;
+    case 1:
+        *operation = 'w';
+        break;
+    case 3:
+        if (p == e) return false;
+        *operation = (char)*p++;
+        break;
+    default:
+        return false;
+    }
+    uint32_t zigzag = (tag >> 4) & 7;
+    if (tag & 0x80) {
+        uint32_t shift = 3;
+        uint8_t byte;
+        do {
+            if (p == e || shift > 31) return false;
+            byte = *p++;
+            zigzag |= (uint32_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+    }
+    uint32_t delta = (zigzag >> 1) ^ (0u - (zigzag & 1));
+    this->prevAddress += delta;
+    *address = this->prevAddress;
+    if (size != nullptr) *size = 1u << ((tag >> 2) & 3);
+    this->cur = (const char *)p;
+    return true;
+}
+
+bool TraceReader::next(char *operation, uint32_t *address, uint32_t *size, uint32_t *pc) {
+    if (this->decoder != nullptr) {
+        return this->nextDecoded(operation, address, size, pc);
+    }
+    if (pc != nullptr) *pc = 0;
+    for (;;) {
+        if (this->format == BINARY) {
+            if (this->decodeRecord(operation, address, size)) return true;
+        } else if (parseRecord(&this->cur, this->end, this->lastWindow, operation, address)) {
+            if (size != nullptr) *size = 1;
+            return true;
+        }
+        if (!this->retryWindow()) {
+            return false;
+        }
+    }
+}
+
+// the accesses of a decoded record are handed out one per call
+bool TraceReader::nextDecoded(char *operation, uint32_t *address, uint32_t *size, uint32_t *pc) {
+    while (this->pendingPos == this->numPending) {
+        this->pendingPos = 0;
+        this->numPending = 0;
+        if (!this->decoder->decode(&this->cur, this->end, this->lastWindow, this->pending, &this->numPending) &&
+            !this->retryWindow()) {
+            return false;
+        }
+    }
+    const TraceAccess &access = this->pending[this->pendingPos++];
+    *operation = access.operation;
+    *address = access.address;
+    if (size != nullptr) *size = access.size;
+    if (pc != nullptr) *pc = access.pc;
+    return true;
+}
+
+// continue with a window starting at the cut record. A window that brings
+// no more bytes before the end of the trace means the record is malformed
+// rather than cut
+bool TraceReader::retryWindow() {
+    if (this->lastWindow) {
+        return false;
+    }
+    size_t left = this->end - this->cur;
+    return this->advanceWindow() && ((size_t)(this->end - this->cur) > left || this->lastWindow);
+}
+
+bool TraceReader::advanceWindow() {
+    if (this->decompressor != nullptr) {
+        return this->refillBuffer();
+    }
+    return this->mapWindow(this->windowOffset + (this->cur - this->window));
+}
+
+// map the window holding the file from offset on, the parsed part before it is dropped
+bool TraceReader::mapWindow(uint64_t offset) {
+    uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t alignedOffset = offset / pageSize * pageSize;
+    this->unmapWindow();
+#if defined(POSIX_FADV_DONTNEED)
+    if (alignedOffset > 0) posix_fadvise(this->fd, 0, alignedOffset, POSIX_FADV_DONTNEED);
+#endif
+    size_t length = this->fileSize - alignedOffset < WINDOW_SIZE ? this->fileSize - alignedOffset : WINDOW_SIZE;
+    if (length > 0) {
+#if defined(__linux__)
+        void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, this->fd, alignedOffset);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+        madvise(p, length, MADV_SEQUENTIAL);
+        this->window = (const char *)p;
+#else
+        this->buffer.resize(length);
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = pread(this->fd, this->buffer.data() + done, length - done, alignedOffset + done);
+            if (n <= 0) {
+                return false;
+            }
+            done += n;
+        }
+        this->window = this->buffer.data();
+#endif
+    }
+    this->windowOffset = alignedOffset;
+    this->windowLength = length;
+    this->cur = this->window + (offset - alignedOffset);
+    this->end = this->window + length;
+    this->lastWindow = alignedOffset + length >= this->fileSize;
+    return true;
+}
+
+void TraceReader::unmapWindow() {
+#if defined(__linux__)
+    // the window of a compressed file is the buffer
+    if (this->window != nullptr && this->decompressor == nullptr) {
+        munmap((void *)this->window, this->windowLength);
+    }
+#endif
+    this->window = nullptr;
+    this->windowLength = 0;
+    this->cur = nullptr;
+    this->end = nullptr;
+    this->lastWindow = true;
+}
+
+// a new decompressor from the start of the file, or from the head already
+// read off a pipe, with enough of the trace in the buffer to tell its format
+bool TraceReader::startDecompressor(const uint8_t *head, size_t headLength) {
+    delete this->decompressor;
+    this->decompressor = nullptr;
+    if (this->seekable && lseek(this->fd, 0, SEEK_SET) != 0) {
+        return false;
+    }
+    this->decompressor = new TraceDecompressor();
+    if (!this->decompressor->start(this->fd, this->codec, head, headLength)) {
+        return false;
+    }
+    this->buffer.reserve(TraceDecompressor::CHUNK_SIZE + 64);
+    this->window = this->buffer.data();
+    this->cur = this->window;
+    this->end = this->window;
+    this->lastWindow = false;
+    // a pipe may deliver less than the binary header at first
+    do {
+        if (!this->refillBuffer()) {
+            return false;
+        }
+    } while ((size_t)(this->end - this->window) < TraceWriter::HEADER_SIZE && !this->lastWindow);
+    return true;
+}
+
+// move the unparsed tail to the front of the buffer and append the next chunk
+bool TraceReader::refillBuffer() {
+    size_t left = this->end - this->cur;
+    if (left > 0) memmove(this->buffer.data(), this->cur, left);
+    size_t length = 0;
+    bool last = true;
+    const char *chunk = this->decompressor->nextChunk(&length, &last);
+    if (chunk == nullptr) {
+        length = 0;
+        last = true;
+    }
+    this->buffer.resize(left + length);
+    if (length > 0) memcpy(this->buffer.data() + left, chunk, length);
+    this->window = this->buffer.data();
+    this->windowLength = left + length;
+    this->cur = this->window;
+    this->end = this->window + this->windowLength;
+    this->lastWindow = last;
+    return !this->decompressor->failed();
+}
+
+bool TraceBuffer::load(const char *path, TraceReader::Format format) {
+    TraceReader reader;
+    if (!reader.open(path, format)) {
+        return false;
+    }
+    this->addresses.clear();
+    this->kinds.clear();
+    char operation;
+    uint32_t address;
+    uint32_t size;
+    while (reader.next(&operation, &address, &size)) {
+        this->append(operation == 'r' ? READ : operation == 'w' ? WRITE : OTHER, address, size);
+    }
+    this->addresses.shrink_to_fit();
+    this->kinds.shrink_to_fit();
+    return true;
+}
+
+TraceWriter::TraceWriter() {
+    this->file = nullptr;
+    this->numRecords = 0;
+    this->prevAddress = 0;
+}
+
+TraceWriter::~TraceWriter() {
+    this->close();
+}
+
+bool TraceWriter::open(const char *path) {
+    this->close();
+    this->file = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+    if (this->file == nullptr) {
+        return false;
+    }
+    this->numRecords = 0;
+    this->prevAddress = 0;
+    // the number of records is filled in by close()
+    uint8_t header[HEADER_SIZE] = {0};
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    memcpy(header + sizeof(MAGIC), &VERSION, sizeof(VERSION));
+    fwrite(header, 1, HEADER_SIZE, this->file);
+    return true;
+}
+
+void TraceWriter::write(char operation, uint32_t address, uint32_t size) {
+    uint8_t record[7];
+    uint32_t length = 1;
+    uint8_t tag;
+    if (operation == 'r') {
+        tag = 0;
+    } else if (operation == 'w') {
+        tag = 1;
+    } else {
+        tag = 3;
+        record[length++] = (uint8_t)operation;
+    }
+    uint32_t sizeBits = size >= 8 ? 3 : size >= 4 ? 2 : size >= 2 ? 1 : 0;
+    uint32_t delta = address - this->prevAddress;
+    uint32_t zigzag = (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+    tag |= sizeBits << 2;
+    tag |= (zigzag & 7) << 4;
+    zigzag >>= 3;
+    if (zigzag != 0) {
+        tag |= 0x80;
+        while (zigzag >= 0x80) {
+            record[length++] = (uint8_t)(zigzag | 0x80);
+            zigzag >>= 7;
+        }
+        record[length++] = (uint8_t)zigzag;
+    }
+    record[0] = tag;
+    fwrite(record, 1, length, this->file);
+    this->prevAddress = address;
+    this->numRecords++;
+}
+
+bool TraceWriter::close() {
+    if (this->file == nullptr) {
+        return true;
+    }
+    // a pipe can't seek back, its header keeps 0 records
+    if (fseek(this->file, sizeof(MAGIC) + 2 * sizeof(uint32_t), SEEK_SET) == 0) {
+        fwrite(&this->numRecords, sizeof(this->numRecords), 1, this->file);
+    }
+    bool ok = ferror(this->file) == 0;
+    ok = (this->file == stdout ? fflush(this->file) : fclose(this->file)) == 0 && ok;
+    this->file = nullptr;
+    return ok;
+}